@@ -0,0 +1,342 @@
+#include <cstring>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "power.hpp"
+
+namespace wxpower
+{
+    /* RX setups are expensive, so each one is built on first use and kept
+       for the rest of the run. Benchmarks which don't need RX never pay for
+       it. */
+    static RxManager& getLightRx()
+    {
+        static std::unique_ptr<RxManager> rx;
+
+        if (!rx)
+        {
+            Bigint K;
+            rx = std::make_unique<RxManager>(false, K);
+        }
+
+        return *rx;
+    }
+
+    static RxManager& getFullRx()
+    {
+        static std::unique_ptr<RxManager> rx;
+        static const std::atomic<bool> cancelled(false);
+
+        if (!rx)
+        {
+            std::vector<u32> initCores;
+
+            for (u32 i = 0; i < std::thread::hardware_concurrency(); i++)
+                initCores.push_back(i);
+
+            Bigint K;
+            // One VM; benchmark threads aren't pinned, so its core is nominal
+            rx = std::make_unique<RxManager>(
+                false, K, initCores, std::vector<u32>{0}, cancelled);
+        }
+
+        return *rx;
+    }
+
+    /* Hashes consecutive nonces exactly like the prover loop. Arg 0 selects
+       the blocking (0) or pipelined (1) RX API. */
+    static void hashLoop(benchmark::State& state, randomx_vm* vm)
+    {
+        const bool pipelined = (state.range(0) != 0);
+        NonceInput H("A typical message body of a few dozen characters.");
+        Bigint out;
+
+        if (pipelined)
+        {
+            randomx_calculate_hash_first(vm, H.data(), H.size());
+
+            for (auto _ : state)
+            {
+                H.incr();
+                randomx_calculate_hash_next(vm, H.data(), H.size(), out.getBytes());
+                benchmark::DoNotOptimize(out.getBytes());
+            }
+
+            randomx_calculate_hash_last(vm, out.getBytes());
+        }
+        else
+        {
+            for (auto _ : state)
+            {
+                randomx_calculate_hash(vm, H.data(), H.size(), out.getBytes());
+                benchmark::DoNotOptimize(out.getBytes());
+                H.incr();
+            }
+        }
+
+        state.counters["hashes/s"] = benchmark::Counter(
+            static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    }
+
+    static void BM_HashLight(benchmark::State& state)
+    {
+        hashLoop(state, getLightRx().getVM(0));
+    }
+
+    static void BM_HashFull(benchmark::State& state)
+    {
+        hashLoop(state, getFullRx().getVM(0));
+    }
+
+    /* Progress-counter stores as done by hash threads, with the counters
+       packed next to each other (the old layout, which false-shares) versus
+       one `ProveV0Manager::ThreadGuarded` block per thread. */
+    static constexpr u32 maxCounterThreads = 128;
+
+    static void counterLoop(benchmark::State& state, std::atomic<u64>& counter)
+    {
+        u64 local = 0;
+
+        for (auto _ : state)
+        {
+            // A little work per "hash", then the store the prover makes
+            benchmark::DoNotOptimize(local += 3);
+            counter.store(local);
+        }
+
+        state.counters["stores/s"] = benchmark::Counter(
+            static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    }
+
+    static void BM_CountersPacked(benchmark::State& state)
+    {
+        static std::atomic<u64> counters[maxCounterThreads];
+        counterLoop(state, counters[state.thread_index()]);
+    }
+
+    static void BM_CountersIsolated(benchmark::State& state)
+    {
+        static ProveV0Manager::ThreadGuarded counters[maxCounterThreads];
+        counterLoop(state, counters[state.thread_index()].hashes);
+    }
+
+    // Arg 0 is the hash's leading zero bits, i.e. its difficulty
+    static void BM_CalcLZCDiff(benchmark::State& state)
+    {
+        Bigint hash;
+        u8* bytes = hash.getBytes();
+        const u32 zeros = static_cast<u32>(state.range(0));
+
+        memset(bytes, 0, 32);
+
+        if (zeros < 256)
+            bytes[zeros / 8] = static_cast<u8>(0x80 >> (zeros % 8));
+
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(hash);
+            benchmark::DoNotOptimize(PowerV0::calcLZCDiff(hash));
+        }
+    }
+
+    // Arg 0 is the counter's starting length in digits
+    static void BM_Base64Incr(benchmark::State& state)
+    {
+        Base64 ctr(UINT64_C(1) << (6 * (state.range(0) - 1)));
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(ctr.incr());
+    }
+
+    static void BM_Base64ToString(benchmark::State& state)
+    {
+        const Base64 val(UINT64_C(1) << (6 * (state.range(0) - 1)));
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(val.toString());
+    }
+
+    static void BM_BigintToString(benchmark::State& state)
+    {
+        Bigint val;
+
+        for (u32 i = 0; i < 32; i++)
+            val.getBytes()[i] = static_cast<u8>(i * 37);
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(val.toString());
+    }
+
+    /* A post of `bytes` bytes. Arg 1 selects the padding around it: none
+       (0), ASCII spaces and newlines (1) or U+3000 ideographic spaces (2),
+       each making up half the message. */
+    static std::string makeMessage(size_t bytes, u32 padding)
+    {
+        const std::string text = "The quick brown fox jumps over the lazy dog. ";
+        const std::string pad = (padding == 1) ? " \n" : "\xe3\x80\x80";
+        std::string body;
+        std::string around;
+
+        while (body.size() < bytes)
+            body += text;
+
+        body.resize(bytes);
+
+        if (padding != 0)
+            while (around.size() < (bytes / 4))
+                around += pad;
+
+        return around + body + "|wxPoW0|someone@example.com|A reply" + around;
+    }
+
+    /* `trimmedBody`, which `trimBody` wraps, so that copying the message
+       for `trimBody` to trim in place isn't what gets timed */
+    static void BM_TrimBody(benchmark::State& state)
+    {
+        const std::string msg = makeMessage(state.range(0), static_cast<u32>(state.range(1)));
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(PowerV0::trimmedBody(msg));
+
+        state.SetBytesProcessed(state.iterations() * msg.size());
+    }
+
+    // Exposes the parser, which is protected
+    class BenchPowerV0 : public PowerV0
+    {
+    public:
+        using PowerV0::msgToContent;
+    };
+
+    static void BM_MsgToContent(benchmark::State& state)
+    {
+        const std::string msg = makeMessage(state.range(0), static_cast<u32>(state.range(1)));
+        BenchPowerV0 power;
+
+        for (auto _ : state)
+        {
+            PowerV0::ProofContent content;
+            benchmark::DoNotOptimize(power.msgToContent(content, msg));
+            benchmark::DoNotOptimize(content);
+        }
+
+        state.SetBytesProcessed(state.iterations() * msg.size());
+    }
+
+    static void BM_ParseProof(benchmark::State& state)
+    {
+        const std::string msg = makeMessage(state.range(0), static_cast<u32>(state.range(1)));
+
+        for (auto _ : state)
+        {
+            PowerV0::ProofView view;
+            benchmark::DoNotOptimize(PowerV0::parseProof(msg, view));
+            benchmark::DoNotOptimize(view.body);
+        }
+
+        state.SetBytesProcessed(state.iterations() * msg.size());
+    }
+
+    // Arg 0 is the length of both the user ID and the context
+    static void BM_ContentToMetaData(benchmark::State& state)
+    {
+        PowerV0::ProofContent content;
+        content.userId.assign(state.range(0), 'u');
+        content.context.assign(state.range(0), 'c');
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(PowerV0::contentToMetaData(content));
+    }
+
+    static void BM_Sha256(benchmark::State& state)
+    {
+        const std::string data(state.range(0), 'm');
+        Sha256 sha256;
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(
+                sha256.doHash(data.c_str(), static_cast<u32>(data.size())));
+
+        state.SetBytesProcessed(state.iterations() * data.size());
+    }
+
+    BENCHMARK(BM_CalcLZCDiff)->ArgName("zeros")->Arg(0)->Arg(9)->Arg(40)->Arg(100)->Arg(256);
+    BENCHMARK(BM_Base64Incr)->ArgName("digits")->DenseRange(1, 11, 5);
+    BENCHMARK(BM_Base64ToString)->ArgName("digits")->DenseRange(1, 11, 5);
+    BENCHMARK(BM_BigintToString);
+
+    // Bodies from a short post to a long one, with each kind of padding
+    BENCHMARK(BM_TrimBody)->ArgNames({ "bytes", "padding" })
+        ->ArgsProduct({ benchmark::CreateRange(64, 64 << 10, 16), { 0, 1, 2 } });
+    BENCHMARK(BM_MsgToContent)->ArgNames({ "bytes", "padding" })
+        ->ArgsProduct({ benchmark::CreateRange(64, 64 << 10, 16), { 0, 1, 2 } });
+    BENCHMARK(BM_ParseProof)->ArgNames({ "bytes", "padding" })
+        ->ArgsProduct({ benchmark::CreateRange(64, 64 << 10, 16), { 0, 1, 2 } });
+
+    BENCHMARK(BM_ContentToMetaData)->ArgName("bytes")->RangeMultiplier(8)->Range(8, 512);
+    BENCHMARK(BM_Sha256)->ArgName("bytes")->RangeMultiplier(4)->Range(32, 16 << 10);
+
+    /* A thread export of `bytes` bytes: posts of about 4 KB, separated by
+       "\x1e", a quarter of them signed. */
+    static const std::string& getExport(size_t bytes)
+    {
+        static std::map<size_t, std::string> docs;
+        std::string& doc = docs[bytes];
+
+        if (doc.empty())
+        {
+            const std::string text = "<p>Lorem ipsum dolor sit amet, | consectetur</p>\n";
+
+            for (u32 post = 0; doc.size() < bytes; post++)
+            {
+                for (u32 i = 0; i < 4096 / text.size(); i++)
+                    doc += text;
+
+                if ((post % 4) == 0)
+                    doc += "|wxPoW0|user" + std::to_string(post) + "|thread\x1e";
+                else
+                    doc += '\x1e';
+            }
+        }
+
+        return doc;
+    }
+
+    static void BM_FindMagic(benchmark::State& state)
+    {
+        const std::string& doc = getExport(state.range(0));
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(ProofExtractorV0::findMagic(doc));
+
+        state.SetBytesProcessed(state.iterations() * doc.size());
+    }
+
+    static void BM_Extract(benchmark::State& state)
+    {
+        const std::string& doc = getExport(state.range(0));
+        const ProofExtractorV0 extractor(ProofExtractorV0::separatedBy("\x1e"));
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(extractor.extract(doc));
+
+        state.SetBytesProcessed(state.iterations() * doc.size());
+    }
+
+    BENCHMARK(BM_FindMagic)->Arg(1 << 16)->Arg(1 << 20)->Arg(64 << 20);
+    BENCHMARK(BM_Extract)->Arg(1 << 16)->Arg(1 << 20)->Arg(64 << 20);
+
+    BENCHMARK(BM_CountersPacked)->ThreadRange(1, 64)->UseRealTime();
+    BENCHMARK(BM_CountersIsolated)->ThreadRange(1, 64)->UseRealTime();
+
+    BENCHMARK(BM_HashLight)->ArgName("pipelined")->Arg(0)->Arg(1)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_HashFull)->ArgName("pipelined")->Arg(0)->Arg(1)
+        ->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_MAIN();
@@ -2,24 +2,33 @@
 #include <cerrno>
 #include <cinttypes>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 
 #include <algorithm>
 #include <array>
 #include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <iostream>
 #include <sstream>
 #include <string_view>
 #include <type_traits>
 
-#ifndef _WIN32
+#ifdef _WIN32
+# include <intrin.h>
+#else
 # include <sys/random.h>
+# include <sys/syscall.h>
 # include <sched.h>
 # include <pthread.h>
+# include <unistd.h>
 # include <openssl/evp.h>
 #endif
 
 #include "power.hpp"
+#include "simd.hpp"
 
 #include "configuration.h"
 
@@ -34,6 +43,8 @@ static_assert(RANDOMX_CACHE_ACCESSES == 10, "Incorrect RX build configuration");
 static_assert(RANDOMX_DATASET_EXTRA_SIZE == 33554304, "Incorrect RX build configuration");
 static_assert(RANDOMX_PROGRAM_SIZE == 192, "Incorrect RX build configuration");
 
+static const char* const checkpointMagic = "wxPoWer checkpoint v0";
+
 namespace wxpower
 {
     bool strToDbl(const std::string& in, double& out)
@@ -102,6 +113,251 @@ namespace wxpower
         return ret;
     }
 
+    NumaTopology NumaTopology::detect()
+    {
+        NumaTopology ret;
+
+#ifdef _WIN32
+        ULONG highest = 0;
+
+        if (GetNumaHighestNodeNumber(&highest))
+            for (ULONG node = 0; node <= highest; node++)
+            {
+                ULONGLONG mask = 0;
+                ret.nodeCores.emplace_back();
+
+                // Processor group 0 only, like `setThreadAffinity`
+                if (GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask))
+                    for (u32 core = 0; core < 64; core++)
+                        if (mask & (static_cast<ULONGLONG>(1) << core))
+                            ret.nodeCores.back().push_back(core);
+            }
+#else
+        std::error_code ec;
+
+        for (const std::filesystem::directory_entry& entry :
+            std::filesystem::directory_iterator("/sys/devices/system/node", ec))
+        {
+            const std::string name = entry.path().filename().string();
+            u32 node;
+            char extra;
+
+            if ((name.compare(0, 4, "node") != 0) ||
+                (sscanf(name.c_str() + 4, "%" SCNu32 "%c", &node, &extra) != 1))
+                continue;
+
+            std::ifstream in(entry.path() / "cpulist");
+            std::string list;
+            std::getline(in, list);
+
+            const std::optional<std::vector<u32>> cores = parseCpuList(list);
+
+            if (!in || !cores.has_value() || (node > 1023))
+                continue;
+
+            if (ret.nodeCores.size() <= node)
+                ret.nodeCores.resize(node + 1);
+
+            ret.nodeCores.at(node) = cores.value();
+        }
+#endif
+
+        // No NUMA information; treat the machine as one node
+        if (ret.nodeCores.empty())
+        {
+            ret.nodeCores.emplace_back();
+
+            for (u32 core = 0; core < std::thread::hardware_concurrency(); core++)
+                ret.nodeCores.back().push_back(core);
+        }
+
+        return ret;
+    }
+
+    std::optional<u32> NumaTopology::nodeOf(u32 core) const
+    {
+        for (size_t node = 0; node < nodeCores.size(); node++)
+            if (std::find(nodeCores[node].cbegin(), nodeCores[node].cend(), core) !=
+                nodeCores[node].cend())
+                return static_cast<u32>(node);
+
+        return std::nullopt;
+    }
+
+    std::optional<std::vector<u32>> NumaTopology::parseCpuList(const std::string& list)
+    {
+        std::vector<u32> ret;
+        std::stringstream ss(list);
+        std::string range;
+
+        while (std::getline(ss, range, ','))
+        {
+            // Trailing newline or spaces
+            while (!range.empty() && isspace(static_cast<unsigned char>(range.back())))
+                range.pop_back();
+
+            if (range.empty() && ss.eof() && ret.empty())
+                break;
+
+            u32 first;
+            u32 last;
+            int consumed = 0;
+
+            if (sscanf(range.c_str(), "%" SCNu32 "-%" SCNu32 "%n", &first, &last, &consumed) == 2)
+            {
+                if ((static_cast<size_t>(consumed) != range.size()) || (last < first) ||
+                    ((last - first) > 4096))
+                    return std::nullopt;
+            }
+            else if ((sscanf(range.c_str(), "%" SCNu32 "%n", &first, &consumed) == 1) &&
+                (static_cast<size_t>(consumed) == range.size()))
+                last = first;
+            else
+                return std::nullopt;
+
+            // sscanf would accept a sign
+            if (!isdigit(static_cast<unsigned char>(range.front())))
+                return std::nullopt;
+
+            for (u64 core = first; core <= last; core++)
+                ret.push_back(static_cast<u32>(core));
+        }
+
+        return ret;
+    }
+
+#ifndef _WIN32
+    // First number in a file, e.g. a cgroup limit; nullopt for "max"
+    static std::optional<u64> readU64File(const char* path)
+    {
+        std::ifstream in(path);
+        u64 value;
+
+        if (in >> value)
+            return value;
+
+        return std::nullopt;
+    }
+#endif
+
+    std::string jsonEscape(const std::string& str)
+    {
+        std::string ret;
+        ret.reserve(str.size());
+
+        for (const char c : str)
+        {
+            switch (c)
+            {
+            case '"':  ret += "\\\""; break;
+            case '\\': ret += "\\\\"; break;
+            case '\n': ret += "\\n"; break;
+            case '\r': ret += "\\r"; break;
+            case '\t': ret += "\\t"; break;
+            default:
+                if (static_cast<u8>(c) < 0x20)
+                {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", static_cast<u8>(c));
+                    ret += buf;
+                }
+                else
+                    ret += c;
+            }
+        }
+
+        return ret;
+    }
+
+    std::string unescapeLine(const std::string& line)
+    {
+        std::string ret;
+        ret.reserve(line.size());
+
+        for (size_t i = 0; i < line.size(); i++)
+        {
+            const char next = (i + 1 < line.size()) ? line[i + 1] : '\0';
+
+            if ((line[i] == '\\') && ((next == 'n') || (next == 'r') || (next == '\\')))
+            {
+                ret += (next == 'n') ? '\n' : ((next == 'r') ? '\r' : '\\');
+                i++;
+            }
+            else
+                ret += line[i];
+        }
+
+        return ret;
+    }
+
+    bool parseCount(const char* str, u64& out, u64 max)
+    {
+        char* end = nullptr;
+
+        if ((str == nullptr) || (*str < '0') || (*str > '9'))
+            return false;
+
+        errno = 0;
+        const unsigned long long value = strtoull(str, &end, 10);
+
+        if ((*end != '\0') || (errno == ERANGE) || (value > max))
+            return false;
+
+        out = value;
+
+        return true;
+    }
+
+    std::optional<u64> getAvailableMemory()
+    {
+        std::optional<u64> ret;
+
+#ifdef _WIN32
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+
+        if (GlobalMemoryStatusEx(&status))
+            ret.emplace(status.ullAvailPhys);
+#else
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        u64 value;
+        std::string unit;
+
+        while (meminfo >> key >> value)
+        {
+            std::getline(meminfo, unit);
+
+            if (key == "MemAvailable:")
+            {
+                // Reported in kB
+                ret.emplace(value * 1024);
+                break;
+            }
+        }
+
+        // cgroup v2, then v1 (where no limit reads as a huge number)
+        std::optional<u64> limit = readU64File("/sys/fs/cgroup/memory.max");
+        std::optional<u64> usage = readU64File("/sys/fs/cgroup/memory.current");
+
+        if (!limit.has_value())
+        {
+            limit = readU64File("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+            usage = readU64File("/sys/fs/cgroup/memory/memory.usage_in_bytes");
+        }
+
+        if (limit.has_value())
+        {
+            const u64 headroom = limit.value() - std::min(limit.value(), usage.value_or(0));
+
+            if (!ret.has_value() || (headroom < ret.value()))
+                ret.emplace(headroom);
+        }
+#endif
+
+        return ret;
+    }
+
     char binToHex(u8 bin)
     {
         assert(bin <= 0x0f);
@@ -150,6 +406,42 @@ namespace wxpower
         return ret;
     }
 
+    static bool hexToBin(char hex, u8& out)
+    {
+        if ((hex >= '0') && (hex <= '9'))
+            out = static_cast<u8>(hex - '0');
+        else if ((hex >= 'a') && (hex <= 'f'))
+            out = static_cast<u8>(hex - 'a' + 10);
+        else if ((hex >= 'A') && (hex <= 'F'))
+            out = static_cast<u8>(hex - 'A' + 10);
+        else
+            return false;
+
+        return true;
+    }
+
+    bool Bigint::fromString(const std::string& str, Bigint& out)
+    {
+        if (str.size() != 32 * 2)
+            return false;
+
+        Bigint temp;
+
+        for (u32 i = 0; i < 32; i++)
+        {
+            u8 un, ln;
+
+            if (!hexToBin(str[i * 2], un) || !hexToBin(str[i * 2 + 1], ln))
+                return false;
+
+            temp.buf[i] = static_cast<u8>((un << 4) | ln);
+        }
+
+        out = temp;
+
+        return true;
+    }
+
     Base64::Base64()
         : buf{ 0 }
     {
@@ -173,7 +465,7 @@ namespace wxpower
         : Base64(static_cast<u64>(val))
     {}
 
-    void Base64::incr()
+    u32 Base64::incr()
     {
         u32 i = 0;
 
@@ -189,17 +481,30 @@ namespace wxpower
 
         if (i >= len)
             len = i + 1;
+
+        return (i < maxSize) ? (i + 1) : maxSize;
     }
 
-    std::string Base64::toString() const
+    u32 Base64::size() const
     {
-        std::string ret;
+        return len;
+    }
 
-        for (u32 i = 0; i < len; i++)
+    void Base64::write(char* out, u32 count) const
+    {
+        assert(count <= len);
+
+        for (u32 i = 0; i < count; i++)
         {
             assert(buf[i] <= 0x3f);
-            ret += mapping.at(buf[i]);
+            out[i] = mapping[buf[i]];
         }
+    }
+
+    std::string Base64::toString() const
+    {
+        std::string ret(len, '\0');
+        write(&ret[0], len);
 
         return ret;
     }
@@ -215,6 +520,254 @@ namespace wxpower
     /* 56 */ '4', '5', '6', '7', '8', '9', '-', '_'
     };
 
+    NonceInput::NonceInput(
+        const std::string& body, const Base64& seed_, const Base64& ctr_) :
+        buf(body.size() + 1 + Base64::maxSize + 1 + Base64::maxSize),
+        seedPos(body.size() + 1)
+    {
+        memcpy(buf.data(), body.data(), body.size());
+        buf[body.size()] = '|';
+        set(seed_, ctr_);
+    }
+
+    void NonceInput::incr()
+    {
+        const u32 changed = ctr.incr();
+        ctr.write(buf.data() + ctrPos, changed);
+    }
+
+    void NonceInput::set(const Base64& seed_, const Base64& ctr_)
+    {
+        seed = seed_;
+        ctr = ctr_;
+
+        seed.write(buf.data() + seedPos, seed.size());
+        ctrPos = seedPos + seed.size() + 1;
+        buf[ctrPos - 1] = '|';
+        ctr.write(buf.data() + ctrPos, ctr.size());
+    }
+
+    const char* NonceInput::data() const
+    {
+        return buf.data();
+    }
+
+    size_t NonceInput::size() const
+    {
+        return ctrPos + ctr.size();
+    }
+
+    const Base64& NonceInput::getSeed() const
+    {
+        return seed;
+    }
+
+    const Base64& NonceInput::getCtr() const
+    {
+        return ctr;
+    }
+
+    NonceScheduler::NonceScheduler(u64 blockSize_, u64 firstNonce) :
+        blockSize(blockSize_), cursor(firstNonce), hasReturned(false)
+    {
+        assert(blockSize > 0);
+    }
+
+    NonceScheduler::Range NonceScheduler::take()
+    {
+        if (hasReturned.load())
+        {
+            std::lock_guard<std::mutex> lock(returnedMutex);
+
+            if (!returned.empty())
+            {
+                const Range ret = returned.back();
+                returned.pop_back();
+                hasReturned.store(!returned.empty());
+
+                return ret;
+            }
+        }
+
+        Range ret;
+        ret.begin = cursor.fetch_add(blockSize);
+        ret.end = ret.begin + blockSize;
+
+        return ret;
+    }
+
+    void NonceScheduler::giveBack(const Range& range)
+    {
+        if (!range.empty())
+        {
+            std::lock_guard<std::mutex> lock(returnedMutex);
+
+            returned.push_back(range);
+            hasReturned.store(true);
+        }
+    }
+
+    u64 NonceScheduler::getCursor() const
+    {
+        return cursor.load();
+    }
+
+    std::vector<NonceScheduler::Range> NonceScheduler::getReturned() const
+    {
+        std::lock_guard<std::mutex> lock(returnedMutex);
+        return returned;
+    }
+
+    void NonceScheduler::reset(u64 cursor_, const std::vector<Range>& returned_)
+    {
+        std::lock_guard<std::mutex> lock(returnedMutex);
+
+        cursor.store(cursor_);
+        returned.clear();
+
+        for (const Range& range : returned_)
+            if (!range.empty())
+                returned.push_back(range);
+
+        hasReturned.store(!returned.empty());
+    }
+
+    bool ProveV0Checkpoint::save(const std::string& path, std::string& error) const
+    {
+        /* Write then rename, so a crash mid-write never loses the previous
+           checkpoint. */
+        const std::string tempPath = path + ".tmp";
+
+        // Scope
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+
+            if (!out)
+            {
+                error = "Failed to open checkpoint file '" + tempPath + "'";
+                return false;
+            }
+
+            out << checkpointMagic << '\n'
+                << "K " << K.toString() << '\n'
+                << "block " << blockSize << '\n'
+                << "cursor " << cursor << '\n'
+                << "hashes " << hashes << '\n'
+                << "pending " << pending.size() << '\n';
+
+            for (const NonceScheduler::Range& range : pending)
+                out << range.begin << ' ' << range.end << '\n';
+
+            out << "body " << content.body.size() << '\n' << content.body << '\n'
+                << "userId " << content.userId.size() << '\n' << content.userId << '\n'
+                << "context " << content.context.size() << '\n' << content.context << '\n'
+                << "best " << best.diff << ' ' << best.hash.toString() << '\n'
+                << "proof " << best.proof.size() << '\n' << best.proof << '\n'
+                << "end\n";
+
+            if (!out.flush())
+            {
+                error = "Failed to write checkpoint file '" + tempPath + "'";
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tempPath, path, ec);
+
+        if (ec)
+        {
+            error = "Failed to replace checkpoint file '" + path + "': " + ec.message();
+            return false;
+        }
+
+        return true;
+    }
+
+    // Reads "<key> <len>\n<len bytes>\n"
+    static bool readCheckpointString(
+        std::istream& in, const char* key, std::string& out)
+    {
+        std::string thisKey;
+        size_t len = 0;
+
+        if (!(in >> thisKey >> len) || (thisKey != key) || (in.get() != '\n'))
+            return false;
+
+        out.resize(len);
+
+        if ((len > 0) && !in.read(&out[0], static_cast<std::streamsize>(len)))
+            return false;
+
+        return in.get() == '\n';
+    }
+
+    // Reads "<key> <value>"
+    template <typename T>
+    static bool readCheckpointValue(std::istream& in, const char* key, T& out)
+    {
+        std::string thisKey;
+        return (in >> thisKey >> out) && (thisKey == key);
+    }
+
+    bool ProveV0Checkpoint::load(const std::string& path, std::string& error)
+    {
+        std::ifstream in(path, std::ios::binary);
+
+        if (!in)
+        {
+            error = "Failed to open checkpoint file '" + path + "'";
+            return false;
+        }
+
+        ProveV0Checkpoint temp;
+        std::string line;
+        std::string hex;
+        size_t pendingCount = 0;
+        bool ok = std::getline(in, line) && (line == checkpointMagic);
+
+        ok = ok && readCheckpointValue(in, "K", hex) && Bigint::fromString(hex, temp.K);
+        ok = ok && readCheckpointValue(in, "block", temp.blockSize);
+        ok = ok && readCheckpointValue(in, "cursor", temp.cursor);
+        ok = ok && readCheckpointValue(in, "hashes", temp.hashes);
+        ok = ok && readCheckpointValue(in, "pending", pendingCount);
+
+        for (size_t i = 0; ok && (i < pendingCount); i++)
+        {
+            NonceScheduler::Range range;
+            ok = static_cast<bool>(in >> range.begin >> range.end);
+            temp.pending.push_back(range);
+        }
+
+        ok = ok && readCheckpointString(in, "body", temp.content.body);
+        ok = ok && readCheckpointString(in, "userId", temp.content.userId);
+        ok = ok && readCheckpointString(in, "context", temp.content.context);
+        ok = ok && readCheckpointValue(in, "best", temp.best.diff);
+        ok = ok && static_cast<bool>(in >> hex) && Bigint::fromString(hex, temp.best.hash);
+        ok = ok && readCheckpointString(in, "proof", temp.best.proof);
+        ok = ok && static_cast<bool>(in >> line) && (line == "end");
+
+        if (!ok || (temp.blockSize == 0))
+        {
+            error = "Checkpoint file '" + path + "' is malformed";
+            return false;
+        }
+
+        *this = temp;
+
+        return true;
+    }
+
+    std::string ProveV0Checkpoint::fileNameFor(const PowerV0::ProofContent& content)
+    {
+        Sha256 sha256;
+        const std::string toHash =
+            content.body + '|' + PowerV0::contentToMetaData(content);
+
+        return sha256.doHash(toHash.c_str(), static_cast<u32>(toHash.size())).toString()
+            + ".ckpt";
+    }
+
     Sha256::Sha256()
     {
 #ifdef _WIN32
@@ -349,66 +902,214 @@ namespace wxpower
             throw std::runtime_error("Unknown version");
     }
 
-    void ProveV0Manager::hashThreadEntry(ProveV0Manager* mgr, u32 tid, randomx_vm* const vm)
+    void ProveV0Manager::hashThreadEntry(ProveV0Manager* mgr, u32 tid, randomx_vm* vm)
     {
         HashResult& finalBestResult = mgr->masterGuarded.bestResults.at(tid);
 
-        HashResult bestResult;
+        // Non-empty if resumed from a checkpoint
+        HashResult bestResult = finalBestResult;
         u64 localHashes = 0;
 
-        std::atomic<u32>* bestDiff = mgr->threadGuarded.bestDiff.at(tid);
-        std::atomic<u64>* hashes = mgr->threadGuarded.hashes.at(tid);
+        assert(tid < mgr->hashThreadCount);
+        std::atomic<u32>& bestDiff = mgr->threadGuarded[tid].bestDiff;
+        std::atomic<u64>& hashes = mgr->threadGuarded[tid].hashes;
+        std::atomic<randomx_vm*>& nextVM = mgr->threadGuarded[tid].nextVM;
 
-        const Base64 threadSeed(tid);
         const std::string metaData = PowerV0::contentToMetaData(mgr->content);
-        const std::string msgWithThreadSeed =
-            mgr->content.body + '|' + threadSeed.toString() + '|';
+        const u64 blockSize = mgr->scheduler.blockSize;
 
         Bigint thisResult;
-        Base64 ctrSeed;
         u32 minDiff = 256;
 
         if (mgr->diff.has_value())
             minDiff = mgr->diff.value();
 
-        while (true)
-        {
-            if ((localHashes & 0xf) == (tid & 0xf))
-            {
-                if (!mgr->running.load())
-                    break;
+        // A resumed proof may already be good enough
+        if (bestResult.diff >= minDiff)
+            mgr->running.store(false);
 
-                hashes->store(localHashes);
-            }
+        /* Two inputs so that pipelined mode can keep one in flight. `held`
+           is the nonce each one currently contains. */
+        NonceInput H[2] = {
+            NonceInput(mgr->content.body), NonceInput(mgr->content.body)
+        };
+        u64 held[2] = { UINT64_MAX, UINT64_MAX };
 
-            const std::string H = msgWithThreadSeed + ctrSeed.toString();
+        // Remainder of the block being worked on
+        NonceScheduler::Range range;
 
-            randomx_calculate_hash(vm, H.c_str(), H.size(), thisResult.getBytes());
-            const u32 thisDiff = PowerV0::calcLZCDiff(thisResult);
+        // Loads the next nonce into input `i`
+        auto loadNext = [&](u32 i)
+        {
+            if (range.empty())
+                range = mgr->scheduler.take();
+
+            const u64 n = range.begin++;
+
+            // Within the same block and just ahead, so bump digits in place
+            if ((held[i] != UINT64_MAX) && (n > held[i]) && ((n - held[i]) <= 2) &&
+                ((n / blockSize) == (held[i] / blockSize)))
+            {
+                for (u64 k = held[i]; k < n; k++)
+                    H[i].incr();
+            }
+            else
+            {
+                H[i].set(Base64(n / blockSize), Base64(n % blockSize));
+            }
 
-            if (thisDiff > bestResult.diff)
+            held[i] = n;
+        };
+
+        // Returns true if the thread should stop (difficulty reached)
+        auto checkResult = [&](const NonceInput& in)
+        {
+            localHashes++;
+
+            if (PowerV0::isLZCDiffAbove(thisResult, bestResult.diff))
             {
-                bestResult.proof = H + '|' + metaData;
+                const u32 thisDiff = PowerV0::calcLZCDiff(thisResult);
+
+                // Only materialise the proof string on improvement
+                bestResult.proof.assign(in.data(), in.size());
+                bestResult.proof += '|';
+                bestResult.proof += metaData;
                 bestResult.hash = thisResult;
                 bestResult.diff = thisDiff;
-                bestDiff->store(thisDiff);
+                bestDiff.store(thisDiff);
 
                 if (bestResult.diff >= minDiff)
                 {
                     mgr->running.store(false);
-                    break;
+                    return true;
                 }
             }
 
-            ctrSeed.incr();
-            localHashes++;
+            return false;
+        };
+
+        // Called every hash; returns true if the thread should stop or park
+        auto poll = [&]()
+        {
+            if ((localHashes & 0xf) != (tid & 0xf))
+                return false;
+
+            hashes.store(localHashes);
+
+            return !mgr->running.load() || (tid >= mgr->activeThreads.load()) ||
+                mgr->pauseRequested.load() || (nextVM.load() != nullptr);
+        };
+
+        /* Returns false if the job stopped while parked. On true, the thread
+           counts as holding a block until it gives it back. */
+        auto waitUntilActive = [&]()
+        {
+            std::unique_lock<std::mutex> lock(mgr->pauseMutex);
+
+            mgr->pauseCond.wait(lock, [&]()
+            {
+                return !mgr->running.load() ||
+                    ((tid < mgr->activeThreads.load()) && !mgr->pauseRequested.load());
+            });
+
+            if (!mgr->running.load())
+                return false;
+
+            // Under the lock, so a pausing master can't miss us
+            mgr->threadsHolding++;
+            return true;
+        };
+
+        bool stop = false;
+
+        while (!stop && waitUntilActive())
+        {
+            // Hybrid mode: carry on with a full-mode VM once there is one
+            if (randomx_vm* const newVM = nextVM.exchange(nullptr))
+                vm = newVM;
+
+            if (mgr->options.pipelined)
+            {
+                /* Each `randomx_calculate_hash_next` call returns the hash of
+                   the input submitted by the previous call, so the result is
+                   always scored against `H[curr]`, not the input just
+                   loaded. */
+                u32 curr = 0;
+
+                loadNext(curr);
+                randomx_calculate_hash_first(vm, H[curr].data(), H[curr].size());
+
+                while (true)
+                {
+                    const u32 next = curr ^ 1;
+
+                    loadNext(next);
+                    randomx_calculate_hash_next(
+                        vm, H[next].data(), H[next].size(), thisResult.getBytes());
+
+                    const bool found = checkResult(H[curr]);
+                    curr = next;
+
+                    if (found)
+                    {
+                        stop = true;
+                        break;
+                    }
+
+                    if (poll())
+                        break;
+                }
+
+                // Drain the pipeline; the last input was hashed too
+                randomx_calculate_hash_last(vm, thisResult.getBytes());
+
+                if (checkResult(H[curr]))
+                    stop = true;
+            }
+            else
+            {
+                while (true)
+                {
+                    loadNext(0);
+                    randomx_calculate_hash(vm, H[0].data(), H[0].size(), thisResult.getBytes());
+
+                    if (checkResult(H[0]))
+                    {
+                        stop = true;
+                        break;
+                    }
+
+                    if (poll())
+                        break;
+                }
+            }
+
+            hashes.store(localHashes);
+
+            // Let another thread finish this block
+            mgr->scheduler.giveBack(range);
+            range = NonceScheduler::Range();
+
+            // Publish for checkpoints
+            {
+                std::lock_guard<std::mutex> lock(mgr->masterMutex);
+                finalBestResult = bestResult;
+            }
+
+            // Pause scope
+            {
+                std::lock_guard<std::mutex> lock(mgr->pauseMutex);
+                mgr->threadsHolding--;
+            }
+
+            mgr->pauseCond.notify_all();
         }
 
         // Mutex scope
         {
             std::lock_guard<std::mutex> lock(mgr->masterMutex);
             finalBestResult = bestResult;
-            hashes->store(localHashes);
+            hashes.store(localHashes);
             mgr->masterGuarded.threadsRunning--;
             mgr->masterCond.notify_one();
         }
@@ -428,39 +1129,34 @@ namespace wxpower
         const std::vector<u32>& hashCores_,
         bool useLargePages_,
         const std::optional<u32>& diff_,
-        const std::optional<double>& timeLimit_)
+        const std::optional<double>& timeLimit_,
+        const ProveV0Options& options_)
         :
         content(content_), initCores(initCores_), hashCores(hashCores_),
         useLargePages(useLargePages_), diff(diff_), timeLimit(timeLimit_),
+        options(options_),
         hashThreadCount(static_cast<u32>(hashCores.size())),
-        running(true), cancelled(false), state(State::rxIniting)
+        running(true), cancelled(false),
+        activeThreads(static_cast<u32>(hashCores_.size())),
+        pauseRequested(false),
+        scheduler(options_.nonceBlockSize),
+        threadGuarded(new ThreadGuarded[hashCores_.size()]),
+        state(State::rxIniting)
     {
         masterGuarded.threadsRunning = static_cast<u32>(hashCores.size());
-
-        for (size_t i = 0; i < hashCores.size(); i++)
-        {
-            threadGuarded.bestDiff.push_back(new std::atomic<u32>(0));
-            threadGuarded.hashes.push_back(new std::atomic<u64>(0));
-        }
-
         master.emplace(threadEntry, this);
     }
 
     ProveV0Manager::~ProveV0Manager()
     {
         master->join();
-
-        for (size_t i = 0; i < hashCores.size(); i++)
-        {
-            delete threadGuarded.hashes.at(i);
-            delete threadGuarded.bestDiff.at(i);
-        }
     }
 
     void ProveV0Manager::cancel()
     {
         cancelled.store(true);
         running.store(false);
+        wakeHashThreads();
     }
 
     bool ProveV0Manager::isCancelled() const
@@ -468,6 +1164,27 @@ namespace wxpower
         return cancelled.load();
     }
 
+    void ProveV0Manager::setActiveThreads(u32 count)
+    {
+        activeThreads.store(std::min(count, hashThreadCount));
+        wakeHashThreads();
+    }
+
+    void ProveV0Manager::wakeHashThreads()
+    {
+        // Taking the lock orders the caller's store before any waiter's check
+        {
+            std::lock_guard<std::mutex> lock(pauseMutex);
+        }
+
+        pauseCond.notify_all();
+    }
+
+    u32 ProveV0Manager::getActiveThreads() const
+    {
+        return activeThreads.load();
+    }
+
     ProveV0Manager::MasterGuarded ProveV0Manager::getMasterGuardedData()
     {
         std::lock_guard<std::mutex> lock(masterMutex);
@@ -478,12 +1195,13 @@ namespace wxpower
     {
         ProveV0Manager::ThreadGuardedRet ret;
 
-        assert(threadGuarded.bestDiff.size() == threadGuarded.hashes.size());
+        ret.bestDiff.resize(hashThreadCount);
+        ret.hashes.resize(hashThreadCount);
 
-        for (size_t i = 0; i < threadGuarded.bestDiff.size(); i++)
+        for (u32 i = 0; i < hashThreadCount; i++)
         {
-            ret.bestDiff.push_back(threadGuarded.bestDiff.at(i)->load());
-            ret.hashes.push_back(threadGuarded.hashes.at(i)->load());
+            ret.bestDiff[i] = threadGuarded[i].bestDiff.load();
+            ret.hashes[i] = threadGuarded[i].hashes.load();
         }
 
         return ret;
@@ -510,6 +1228,94 @@ namespace wxpower
         return state.load();
     }
 
+    std::optional<ProveV0Checkpoint> ProveV0Manager::loadCheckpoint(const Bigint& K)
+    {
+        std::optional<ProveV0Checkpoint> ret;
+        const std::string& path = options.checkpointPath;
+
+        if (!path.empty() && std::filesystem::exists(path))
+        {
+            ProveV0Checkpoint ckpt;
+            std::string error;
+            std::string warning;
+
+            if (!ckpt.load(path, error))
+                warning = error;
+            else if ((ckpt.content.body != content.body) ||
+                (ckpt.content.userId != content.userId) ||
+                (ckpt.content.context != content.context) ||
+                (memcmp(ckpt.K.getBytes(), K.getBytes(), 32) != 0))
+                warning = "Checkpoint is for different content; starting afresh.";
+            else if (ckpt.blockSize != scheduler.blockSize)
+                warning = "Checkpoint used a different nonce block size; starting afresh.";
+            else
+            {
+                scheduler.reset(ckpt.cursor, ckpt.pending);
+                ret.emplace(ckpt);
+            }
+
+            if (!warning.empty())
+            {
+                std::lock_guard<std::mutex> lock(masterMutex);
+                masterGuarded.warnings.push_back(warning);
+            }
+        }
+
+        return ret;
+    }
+
+    void ProveV0Manager::saveCheckpoint(const Bigint& K, bool pauseThreads)
+    {
+        ProveV0Checkpoint ckpt;
+
+        if (pauseThreads)
+        {
+            std::unique_lock<std::mutex> lock(pauseMutex);
+
+            pauseRequested.store(true);
+            pauseCond.wait(lock, [this]() { return threadsHolding == 0; });
+        }
+
+        // No thread holds a block now, so the scheduler has every gap
+        ckpt.content = content;
+        ckpt.K = K;
+        ckpt.blockSize = scheduler.blockSize;
+        ckpt.cursor = scheduler.getCursor();
+        ckpt.pending = scheduler.getReturned();
+
+        for (u32 t = 0; t < hashThreadCount; t++)
+            ckpt.hashes += threadGuarded[t].hashes.load();
+
+        // Scope
+        {
+            std::lock_guard<std::mutex> lock(masterMutex);
+
+            ckpt.hashes += masterGuarded.resumedHashes.value_or(0);
+
+            for (const HashResult& res : masterGuarded.bestResults)
+                if (res.diff > ckpt.best.diff)
+                    ckpt.best = res;
+        }
+
+        if (pauseThreads)
+        {
+            pauseRequested.store(false);
+            wakeHashThreads();
+        }
+
+        std::string error;
+
+        if (!ckpt.save(options.checkpointPath, error))
+        {
+            std::lock_guard<std::mutex> lock(masterMutex);
+
+            // Only report each distinct problem once
+            if (std::find(masterGuarded.warnings.cbegin(), masterGuarded.warnings.cend(),
+                error) == masterGuarded.warnings.cend())
+                masterGuarded.warnings.push_back(error);
+        }
+    }
+
     void ProveV0Manager::threadEntry(ProveV0Manager* mgr)
     {
         Sha256 sha256;
@@ -518,11 +1324,14 @@ namespace wxpower
         const Bigint K = sha256.doHash(
             metaData.c_str(), static_cast<u32>(metaData.size()));
 
+        const std::optional<ProveV0Checkpoint> resumed = mgr->loadCheckpoint(K);
+        const bool checkpointing = !mgr->options.checkpointPath.empty();
+
         try
         {
             // Throws on error (not cancellation)
-            RxManager rx(mgr->useLargePages, K, mgr->initCores,
-                static_cast<u32>(mgr->hashCores.size()), mgr->cancelled);
+            RxManager rx(mgr->useLargePages, K, mgr->initCores, mgr->hashCores,
+                mgr->cancelled, mgr->options.rxMode, mgr->options.numaReplicas);
 
             assert(mgr->state.load() == ProveV0Manager::State::rxIniting);
 
@@ -542,8 +1351,17 @@ namespace wxpower
                 {
                     std::lock_guard<std::mutex> lock(mgr->masterMutex);
 
-                    mgr->masterGuarded.warnings = rx.warnings;
+                    mgr->masterGuarded.warnings.insert(
+                        mgr->masterGuarded.warnings.end(),
+                        rx.warnings.cbegin(), rx.warnings.cend());
                     mgr->masterGuarded.rxTime = rx.initTime;
+                    mgr->masterGuarded.rxReused = rx.reusedDataset;
+                    mgr->masterGuarded.rxFromSnapshot = rx.loadedSnapshot;
+                    mgr->masterGuarded.rxMode = rx.hybridMode ? RxMode::hybrid :
+                        (rx.lightMode ? RxMode::light : RxMode::full);
+                    mgr->masterGuarded.rxReplicas = rx.getReplicaCount();
+                    mgr->masterGuarded.rxInitStats = rx.initStats;
+                    mgr->masterGuarded.rxResumedItems = rx.resumedItems;
                     mgr->masterGuarded.hashStartTime.emplace(NOW);
 
                     if (mgr->timeLimit.has_value())
@@ -551,10 +1369,14 @@ namespace wxpower
                             std::chrono::duration<double>(mgr->timeLimit.value()));
 
                     for (u32 t = 0; t < mgr->hashThreadCount; t++)
-                    {
                         mgr->masterGuarded.bestResults.emplace_back();
-                        mgr->threadGuarded.bestDiff.push_back(new std::atomic<u32>(0));
-                        mgr->threadGuarded.hashes.push_back(new std::atomic<u64>(0));
+
+                    // Thread 0 carries on from the resumed best result
+                    if (resumed.has_value())
+                    {
+                        mgr->masterGuarded.resumedHashes = resumed->hashes;
+                        mgr->masterGuarded.bestResults.at(0) = resumed->best;
+                        mgr->threadGuarded[0].bestDiff.store(resumed->best.diff);
                     }
 
                     for (u32 t = 0; t < mgr->hashThreadCount; t++)
@@ -567,41 +1389,107 @@ namespace wxpower
                     mgr->masterGuarded.threadsActive = true;
                 }
 
+                // Hybrid mode: build the dataset while the threads hash
+                std::atomic<bool> stopDataset(false);
+                std::thread datasetThread;
+
+                if (rx.hybridMode)
+                    datasetThread = std::thread([&rx, &stopDataset, mgr]()
+                    {
+                        const size_t oldWarnings = rx.warnings.size();
+
+                        if (!rx.completeDataset(stopDataset))
+                            return;
+
+                        std::lock_guard<std::mutex> lock(mgr->masterMutex);
+
+                        mgr->masterGuarded.warnings.insert(mgr->masterGuarded.warnings.end(),
+                            rx.warnings.cbegin() + oldWarnings, rx.warnings.cend());
+                        mgr->masterGuarded.rxMode = RxMode::full;
+                        mgr->masterGuarded.rxDatasetTime.emplace(
+                            SECS(NOW - mgr->masterGuarded.hashStartTime.value()));
+                        mgr->masterGuarded.rxReplicas = rx.getReplicaCount();
+                        mgr->masterGuarded.rxInitStats = rx.initStats;
+                        mgr->masterGuarded.rxResumedItems = rx.resumedItems;
+
+                        // Nonces and best results stay with the threads
+                        for (u32 t = 0; t < mgr->hashThreadCount; t++)
+                            mgr->threadGuarded[t].nextVM.store(rx.getFullVM(t));
+                    });
+
+                std::optional<AbsTime> nextCheckpoint;
+
+                if (checkpointing)
+                    nextCheckpoint.emplace(NOW +
+                        std::chrono::duration<double>(mgr->options.checkpointInterval));
+
                 // Cond scope
                 {
                     std::unique_lock<std::mutex> lock(mgr->masterMutex);
 
-                    if (absTimeLimit.has_value())
+                    auto isDone = [&]()
                     {
-                        mgr->masterCond.wait_until(lock, absTimeLimit.value(), [&]()
-                        {
-                            const NowTime predTime = NOW;
+                        if (absTimeLimit.has_value() && (NOW >= absTimeLimit.value()))
+                            mgr->running.store(false);
 
-                            if (predTime >= absTimeLimit.value())
-                            {
-                                mgr->running.store(false);
-                            }
+                        assert(mgr->masterGuarded.threadsRunning <= mgr->hashThreadCount);
+                        return (!mgr->running.load() || (mgr->masterGuarded.threadsRunning == 0));
+                    };
 
-                            assert(mgr->masterGuarded.threadsRunning <= mgr->hashThreadCount);
-                            return (!mgr->running.load() || (mgr->masterGuarded.threadsRunning == 0));
-                        });
-                    }
-                    else
+                    while (!isDone())
                     {
-                        mgr->masterCond.wait(lock, [&]()
+                        std::optional<AbsTime> wakeTime = absTimeLimit;
+
+                        if (nextCheckpoint.has_value() && (!wakeTime.has_value() ||
+                            (nextCheckpoint.value() < wakeTime.value())))
+                            wakeTime = nextCheckpoint;
+
+                        if (wakeTime.has_value())
+                            mgr->masterCond.wait_until(lock, wakeTime.value(), isDone);
+                        else
+                            mgr->masterCond.wait(lock, isDone);
+
+                        if (nextCheckpoint.has_value() && !isDone() &&
+                            (NOW >= nextCheckpoint.value()))
                         {
-                            assert(mgr->masterGuarded.threadsRunning <= mgr->hashThreadCount);
-                            return (!mgr->running.load() || (mgr->masterGuarded.threadsRunning == 0));
-                        });
+                            // Hash threads need the mutex to pause
+                            lock.unlock();
+                            mgr->saveCheckpoint(K, true);
+                            lock.lock();
+
+                            nextCheckpoint.emplace(NOW +
+                                std::chrono::duration<double>(mgr->options.checkpointInterval));
+                        }
                     }
                 }
 
                 assert(!mgr->running.load());
                 const bool wasCancelled = mgr->isCancelled();
-                
+
+                // Parked threads must see `running` is false to quit
+                mgr->wakeHashThreads();
+
+                // No point finishing the dataset for a job that's over
+                stopDataset.store(true);
+
+                if (datasetThread.joinable())
+                    datasetThread.join();
+
                 for (u32 t = 0; t < mgr->hashThreadCount; t++)
                     mgr->hashThreads.at(t).join();
 
+                /* Every thread has given back its block and published its
+                   best, so this is exact. A finished job keeps its
+                   checkpoint too, to be mined further later, unless asked
+                   not to. */
+                if (checkpointing && !wasCancelled && mgr->options.deleteCheckpointOnFinish)
+                {
+                    std::error_code ec;
+                    std::filesystem::remove(mgr->options.checkpointPath, ec);
+                }
+                else if (checkpointing)
+                    mgr->saveCheckpoint(K, false);
+
                 // Mutex scope
                 {
                     std::lock_guard<std::mutex> lock(mgr->masterMutex);
@@ -635,35 +1523,21 @@ namespace wxpower
         std::string& error)
     {
         bool ret = false;
-        std::string proofTrimmed = proof;
-        ProofContent content;
+        ProofView view;
 
         prettyMetaData.clear();
         error.clear();
-        trimBody(proofTrimmed);
 
         try
         {
-            if (msgToContent(content, proofTrimmed))
+            if (parseProof(proof, view))
             {
                 /* Ret only indicates proof version correctness. Set now
                    in case of failure later. */
                 ret = true;
 
-                const std::string metaData = contentToMetaData(content);
-
-                // Scope
-                {
-                    std::stringstream ss;
-
-                    ss << "---- BEGIN BODY ----\n"
-                        << content.body
-                        << "\n----END BODY----\n"
-                        << "\nUser ID: " << content.userId
-                        << "\nContext: " << content.context;
-
-                    prettyMetaData = ss.str();
-                }
+                const std::string metaData = contentToMetaData(view);
+                prettyMetaData = contentToPrettyMetaData(view);
 
                 Sha256 sha256;
                 const Bigint K = sha256.doHash(
@@ -674,10 +1548,11 @@ namespace wxpower
 
                 res.emplace();
                 randomx_calculate_hash(
-                    vm, content.body.c_str(), content.body.size(),
+                    vm, view.body.data(), view.body.size(),
                     res->hash.getBytes());
 
-                res->proof = content.body + '|' + metaData;
+                res->proof.reserve(view.body.size() + 1 + metaData.size());
+                res->proof.append(view.body).append(1, '|').append(metaData);
                 res->diff = calcLZCDiff(res->hash);
             }
         }
@@ -689,192 +1564,397 @@ namespace wxpower
         return ret;
     }
 
+    static inline u64 loadBE64(const u8* buf)
+    {
+        u64 ret = 0;
+
+        // Compilers reduce this to a load and byte swap
+        for (u32 i = 0; i < 8; i++)
+            ret = (ret << 8) | buf[i];
+
+        return ret;
+    }
+
+    static inline u32 countLeadingZeros64(u64 val)
+    {
+        assert(val != 0);
+
+#ifdef _WIN32
+        unsigned long idx;
+        _BitScanReverse64(&idx, val);
+        return 63 - static_cast<u32>(idx);
+#else
+        return static_cast<u32>(__builtin_clzll(val));
+#endif
+    }
+
     u32 PowerV0::calcLZCDiff(const Bigint& bigint)
     {
         const u8* buf = bigint.getBytes();
 
-        for (u32 i = 0; i < 32; i++)
-            for (u32 j = 0; j < 8; j++)
-            {
-                const u32 idx = i * 8 + j;
-                const unsigned char diffmask = 1 << (7 - j);
+        for (u32 i = 0; i < 4; i++)
+        {
+            const u64 word = loadBE64(buf + i * 8);
 
-                if (buf[i] & diffmask)
-                    return idx;
-            }
+            if (word != 0)
+                return i * 64 + countLeadingZeros64(word);
+        }
 
         return 256;
+    }
+
+    bool PowerV0::isLZCDiffAbove(const Bigint& bigint, u32 diff)
+    {
+        if (diff >= 256)
+            return false;
+
+        const u8* buf = bigint.getBytes();
+
+        // Leading zero bits required to beat `diff`
+        const u32 needed = diff + 1;
+        const u32 wholeBytes = needed / 8;
+        const u32 extraBits = needed % 8;
 
+        for (u32 i = 0; i < wholeBytes; i++)
+            if (buf[i] != 0)
+                return false;
+
+        if (extraBits > 0)
+            return (buf[wholeBytes] >> (8 - extraBits)) == 0;
+
+        return true;
     }
 
-    std::string PowerV0::contentToMetaData(const ProofContent& content)
+    void PowerV0::calcLZCDiffs(const Bigint* bigints, size_t count, u32* out)
+    {
+        for (size_t i = 0; i < count; i++)
+            out[i] = calcLZCDiff(bigints[i]);
+    }
+
+    static std::string metaDataOf(std::string_view userId, std::string_view context)
     {
         std::string ret = "wxPoW0|";
-        ret += content.userId;
+        ret.reserve(ret.size() + userId.size() + 1 + context.size());
+
+        ret += userId;
         ret += '|';
-        ret += content.context;
+        ret += context;
 
         return ret;
     }
 
-    bool PowerV0::msgToContent(ProofContent& proof, const std::string& msgOrig)
+    static std::string prettyMetaDataOf(
+        std::string_view body, std::string_view userId, std::string_view context)
     {
-        bool ret = false;
-        std::string msg = msgOrig;
-        ProofContent out;
+        std::stringstream ss;
 
-        trimBody(msg);
+        ss << "---- BEGIN BODY ----\n"
+            << body
+            << "\n----END BODY----\n"
+            << "\nUser ID: " << userId
+            << "\nContext: " << context;
 
-        const size_t msgLen = msg.size();
-        const size_t pos = msg.rfind(magicSequence);
+        return ss.str();
+    }
 
-        
-        if ((pos != std::string::npos) && (pos > 0))
-        {
-            out.body = msg.substr(0, pos);
-            size_t idx = pos + magicSequence.size();
+    std::string PowerV0::contentToMetaData(const ProofContent& content)
+    {
+        return metaDataOf(content.userId, content.context);
+    }
 
-            bool consuming = true;
-            bool justSawBackslash = false;
+    std::string PowerV0::contentToMetaData(const ProofView& view)
+    {
+        return metaDataOf(view.userId, view.context);
+    }
 
-            if (idx < msgLen)
-            {
-                while (consuming && (idx < msgLen))
-                {
-                    const char c = msg.at(idx);
+    std::string PowerV0::contentToPrettyMetaData(const ProofContent& content)
+    {
+        return prettyMetaDataOf(content.body, content.userId, content.context);
+    }
 
-                    if (c == '\\')
-                        justSawBackslash = true;
-                    else if ((c == '|') && !justSawBackslash)
-                        consuming = false;
-                    else if ((c != '\\') || justSawBackslash)
-                    {
-                        out.userId += c;
-                        justSawBackslash = false;
-                    }
+    std::string PowerV0::contentToPrettyMetaData(const ProofView& view)
+    {
+        return prettyMetaDataOf(view.body, view.userId, view.context);
+    }
 
-                    idx++;
-                }
+    PowerV0::ProofContent PowerV0::ProofView::toContent() const
+    {
+        ProofContent ret;
 
-                justSawBackslash = false;
+        ret.body = body;
+        ret.userId = userId;
+        ret.context = context;
 
-                while (idx < msgLen)
-                {
-                    const char c = msg.at(idx);
+        return ret;
+    }
 
-                    if (c == '\\')
-                        justSawBackslash = true;
-                    else if ((c != '\\') || justSawBackslash)
-                    {
-                        out.context += c;
-                        justSawBackslash = false;
-                    }
+    bool PowerV0::msgToContent(ProofContent& proof, const std::string& msg)
+    {
+        ProofView view;
 
-                    idx++;
-                }
+        if (!parseProof(msg, view))
+            return false;
 
-                proof = out;
-                ret = true;
-            }
-        }
+        proof = view.toContent();
+
+        return true;
+    }
+
+    static std::string withoutBackslashes(std::string_view str)
+    {
+        std::string ret;
+        ret.reserve(str.size());
+
+        for (const char c : str)
+            if (c != '\\')
+                ret += c;
 
         return ret;
     }
 
-    s32 PowerV0::utf8CharsToSkip(const std::string& str, s32 pos)
+    bool PowerV0::parseProof(std::string_view msg, ProofView& out)
     {
-        s32 ret = 0;
-        const char c = str.at(pos);
+        const std::string_view trimmed = trimmedBody(msg);
+        const size_t pos = trimmed.rfind(magicSequence);
+
+        // Needs a body, and something after the magic sequence
+        if ((pos == std::string_view::npos) || (pos == 0) ||
+            ((pos + magicSequence.size()) >= trimmed.size()))
+            return false;
+
+        const std::string_view fields = trimmed.substr(pos + magicSequence.size());
+
+        /* The user ID runs up to the first '|' not straight after a
+           backslash, and the context is the rest. Backslashes are dropped
+           from both. */
+        size_t userIdLen = fields.size();
+        bool userIdEscaped = false;
 
-        if ((c & 0x80) == 0)
+        for (size_t i = 0; i < fields.size(); i++)
         {
-            if (std::binary_search(skippable1.cbegin(), skippable1.cend(), c))
-                ret = 1;
+            if (fields[i] == '\\')
+                userIdEscaped = true;
+            else if ((fields[i] == '|') && ((i == 0) || (fields[i - 1] != '\\')))
+            {
+                userIdLen = i;
+                break;
+            }
         }
-        else if ((c == static_cast<char>(0xc2)) && (static_cast<size_t>(pos + 1) <= str.size()))
-        {
-            const std::string substr2 = str.substr(pos, 2);
 
-            if (std::binary_search(skippable2.cbegin(), skippable2.cend(), substr2))
-                ret = 2;
+        out.body = trimmed.substr(0, pos);
+        out.userId = fields.substr(0, userIdLen);
+        out.context = fields.substr(std::min(userIdLen + 1, fields.size()));
+
+        out.userIdStorage.clear();
+        out.contextStorage.clear();
+
+        if (userIdEscaped)
+        {
+            out.userIdStorage = withoutBackslashes(out.userId);
+            out.userId = out.userIdStorage;
         }
-        else if (static_cast<size_t>(pos + 2) <= str.size())
+
+        if (out.context.find('\\') != std::string_view::npos)
         {
-            const std::string substr3 = str.substr(pos, 3);
+            out.contextStorage = withoutBackslashes(out.context);
+            out.context = out.contextStorage;
+        }
+
+        return true;
+    }
+
+    /* The sequences in `skippable1/2/3`, as big-endian codes. The tests
+       check that these and the tables agree. */
+    static constexpr u32 skippableCodes[] = {
+        0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x20,
+        0xc285, 0xc2a0,
+        0xe19a80, 0xe1a08e, 0xe28080, 0xe28081, 0xe28082, 0xe28083,
+        0xe28084, 0xe28085, 0xe28086, 0xe28087, 0xe28088, 0xe28089,
+        0xe2808a, 0xe2808b, 0xe2808c, 0xe2808d, 0xe280a8, 0xe280a9,
+        0xe280af, 0xe2819f, 0xe281a0, 0xe38080, 0xe3bbbf
+    };
+
+    static constexpr u32 codeLength(u32 code)
+    {
+        return (code > 0xffff) ? 3 : ((code > 0xff) ? 2 : 1);
+    }
 
-            if (std::binary_search(skippable3.cbegin(), skippable3.cend(), substr3))
-                ret = 3;
+    /* For each byte, the length of the skippable sequences it starts, or
+       0 if it starts none. */
+    static constexpr std::array<u8, 256> makeSkipLengths()
+    {
+        std::array<u8, 256> ret{};
+
+        for (const u32 code : skippableCodes)
+        {
+            const u32 len = codeLength(code);
+            ret[code >> ((len - 1) * 8)] = static_cast<u8>(len);
         }
 
         return ret;
     }
 
-    void PowerV0::trimBody(std::string& body)
+    static constexpr std::array<u8, 256> skipLengths = makeSkipLengths();
+
+    static constexpr bool codesSorted()
     {
-        const s32 msgLen = static_cast<s32>(body.size());
-        s32 start = 0;
+        for (size_t i = 1; i < std::size(skippableCodes); i++)
+            if (skippableCodes[i - 1] >= skippableCodes[i])
+                return false;
 
-        if (msgLen > 0)
-        {
-            while (start < static_cast<s32>(body.size()))
-            {
-                const s32 skip = utf8CharsToSkip(body, start);
+        return true;
+    }
 
-                if (skip > 0)
-                    start += skip;
-                else
-                    break;
-            }
+    static_assert(codesSorted(), "skippableCodes must be sorted for binary search");
 
-            s32 end = static_cast<s32>(body.size() - 1);
-            s32 charBytes = 0;
+    s32 PowerV0::utf8CharsToSkip(std::string_view str, s32 pos)
+    {
+        const u32 len = skipLengths[static_cast<u8>(str.at(pos))];
 
-            while ((end - charBytes) >= start)
-            {
-                const char thisC = body.at(end - charBytes);
+        if (len <= 1)
+            return static_cast<s32>(len);
 
-                if ((thisC & 0xc0) == 0x80)
-                    charBytes++;
-                else
-                {
-                    if ((end - charBytes) >= 0)
-                    {
-                        const s32 skip = utf8CharsToSkip(body, end - charBytes);
+        if ((static_cast<size_t>(pos) + len) > str.size())
+            return 0;
 
-                        assert((skip == 0) || ((skip - 1) == charBytes));
+        u32 code = 0;
 
-                        if (skip > 0)
-                        {
-                            // Found trailing UTF-8 whitespace
-                            end -= skip;
-                            charBytes = 0;
-                        }
-                        else
-                        {
-                            // Reached a non-skippable UTF-8 char
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        // Malformed string?
-                        break;
-                    }
-                }
-            }
+        for (u32 i = 0; i < len; i++)
+            code = (code << 8) | static_cast<u8>(str[pos + i]);
 
-            const s32 newLen = end - start + 1;
-            assert(newLen >= 0);
-            assert(newLen <= msgLen);
+        return std::binary_search(std::begin(skippableCodes), std::end(skippableCodes), code) ?
+            static_cast<s32>(len) : 0;
+    }
 
-            if (newLen > 0)
-            {
-                body = body.substr(start, newLen);
-                assert(newLen == static_cast<s32>(body.size()));
-            }
-            else
-                body.clear();
+#ifdef WXPOWER_SSE2
+    // Bit i is set if byte i of `data` is ASCII whitespace
+    static inline u32 asciiWhitespaceMask16(const char* data)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+
+        // '\t' to '\r' map to 0 to 4; everything else to something larger
+        const __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+        const __m128i control = _mm_cmpeq_epi8(
+            _mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+        const __m128i space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+
+        return static_cast<u32>(_mm_movemask_epi8(_mm_or_si128(control, space)));
+    }
+
+    static inline u32 countLeadingZeros16(u32 val)
+    {
+        assert((val != 0) && (val <= 0xffff));
+
+# ifdef _WIN32
+        unsigned long idx;
+        _BitScanReverse(&idx, val);
+        return 15 - static_cast<u32>(idx);
+# else
+        return static_cast<u32>(__builtin_clz(val)) - 16;
+# endif
+    }
+#endif
+
+    /* ASCII whitespace bytes at the front of `data[0, len)`. Padding is
+       usually made of these, so runs are checked 16 bytes at a time. */
+    static size_t asciiWhitespaceFront(const char* data, size_t len)
+    {
+        size_t ret = 0;
+
+#ifdef WXPOWER_SSE2
+        for (; (ret + 16) <= len; ret += 16)
+        {
+            const u32 mask = asciiWhitespaceMask16(data + ret);
+
+            if (mask != 0xffff)
+                return ret + countTrailingZeros32(~mask);
+        }
+#endif
+
+        while ((ret < len) && (skipLengths[static_cast<u8>(data[ret])] == 1))
+            ret++;
+
+        return ret;
+    }
+
+    // As above, at the back
+    static size_t asciiWhitespaceBack(const char* data, size_t len)
+    {
+        size_t ret = 0;
+
+#ifdef WXPOWER_SSE2
+        for (; (ret + 16) <= len; ret += 16)
+        {
+            const u32 mask = asciiWhitespaceMask16(data + len - ret - 16);
+
+            if (mask != 0xffff)
+                return ret + countLeadingZeros16(~mask & 0xffff);
+        }
+#endif
+
+        while ((ret < len) && (skipLengths[static_cast<u8>(data[len - ret - 1])] == 1))
+            ret++;
+
+        return ret;
+    }
+
+    std::string_view PowerV0::trimmedBody(std::string_view body)
+    {
+        size_t start = 0;
+
+        while (start < body.size())
+        {
+            start += asciiWhitespaceFront(body.data() + start, body.size() - start);
+
+            if (start == body.size())
+                break;
+
+            const s32 skip = utf8CharsToSkip(body, static_cast<s32>(start));
+
+            if (skip == 0)
+                break;
+
+            start += skip;
+        }
+
+        size_t end = body.size();
+
+        while (end > start)
+        {
+            end -= asciiWhitespaceBack(body.data() + start, end - start);
+
+            if (end == start)
+                break;
+
+            // Back up to the lead byte of the last character
+            size_t lead = end - 1;
+
+            while ((lead > start) && ((body[lead] & 0xc0) == 0x80))
+                lead--;
+
+            if ((body[lead] & 0xc0) == 0x80)
+                break;
+
+            const size_t skip = static_cast<size_t>(utf8CharsToSkip(body, static_cast<s32>(lead)));
+
+            if (skip == 0)
+                break;
+
+            /* Drops `skip` bytes from the end, as the original walk did in
+               release builds, even when stray continuation bytes follow the
+               whitespace and that isn't the character's own bytes. Proofs
+               hash the trimmed body, so this must not change. */
+            end -= std::min(skip, end - start);
         }
+
+        return body.substr(start, end - start);
+    }
+
+    void PowerV0::trimBody(std::string& body)
+    {
+        const std::string_view trimmed = trimmedBody(body);
+
+        body.assign(trimmed.data(), trimmed.size());
     }
 
     const std::string PowerV0::magicSequence = "|wxPoW0|";
@@ -907,39 +1987,216 @@ namespace wxpower
 
     RxManager::RxManager(
         bool useLargePages_, const Bigint& K_,
-        const std::vector<u32>& initCores_, u32 hashCores_,
-        const std::atomic<bool>& cancelled) :
+        const std::vector<u32>& initCores_, const std::vector<u32>& hashCores_,
+        const std::atomic<bool>& cancelled, RxMode mode, bool numaReplicas_) :
         proveMode(true), useLargePages(useLargePages_), K(K_),
-        initCores(initCores_), hashCores(hashCores_)
+        initCores(initCores_), hashCores(hashCores_), numaReplicas(numaReplicas_)
     {
         const auto tic = NOW;
-        init();
+        RxDatasetCache& datasetCache = RxDatasetCache::instance();
 
-        const u32 initThreads = static_cast<u32>(initCores.size());
-        dataset = randomx_alloc_dataset(flags);
+        dataset = datasetCache.acquire(K);
 
-        if (dataset == nullptr)
+        if (dataset && dataset->isComplete())
+            reusedDataset = true;
+        else if (mode == RxMode::light)
         {
-            std::string what = "Failed to initialize RX dataset.";
+            // Leave any partial dataset for a later full-mode job
+            if (dataset)
+                datasetCache.insert(dataset);
 
-            if (useLargePages)
-                what += " Try disabling large pages.";
+            dataset.reset();
+            lightMode = true;
+        }
+        else if (dataset)
+        {
+            // Cancelled earlier; only the missing chunks get built
+            resumedItems.emplace(dataset->getDoneItems());
+        }
+        else
+        {
+            // Don't hold an unused dataset for another K while building this one
+            datasetCache.makeRoom(RxDataset::getBytes());
 
-            throw Exception(what);
+            if ((mode == RxMode::automatic) || (mode == RxMode::hybrid))
+            {
+                // Hybrid mode has light and full VMs at once
+                const u64 vmSets = (mode == RxMode::hybrid) ? 2 : 1;
+
+                if (!hasRoomForDataset(vmSets * hashCores.size()))
+                {
+                    lightMode = true;
+                    warnings.push_back("Not enough free memory for the RX dataset; "
+                        "proving in light mode.");
+                }
+            }
+        }
+
+        // Only the flags are needed if the dataset doesn't have to be built
+        initFlags();
+
+        if (!dataset && !lightMode)
+        {
+            dataset = RxDataset::alloc(K, flags);
+
+            if (!dataset)
+            {
+                std::string what = "Failed to initialize RX dataset.";
+
+                if (useLargePages)
+                    what += " Try disabling large pages.";
+
+                if (mode == RxMode::full)
+                    throw Exception(what);
+
+                warnings.push_back(what + " Proving in light mode.");
+                lightMode = true;
+            }
+        }
+
+        if (lightMode)
+        {
+            // Throws if even the cache can't be allocated
+            init();
+        }
+        else if (!reusedDataset)
+        {
+            // A failed load could clobber chunks of a partial dataset
+            if (!resumedItems.has_value())
+                loadedSnapshot = datasetCache.loadSnapshot(*dataset, initCores, cancelled, warnings);
+
+            if (!loadedSnapshot && !cancelled.load())
+            {
+                if (mode == RxMode::hybrid)
+                {
+                    // Light-mode VMs hash on the cache while `completeDataset` builds
+                    hybridMode = true;
+                    init();
+                }
+                else
+                {
+                    init();
+                    buildDataset(cancelled);
+
+                    randomx_release_cache(cache);
+                    cache = nullptr;
+                }
+            }
+
+            if (!hybridMode)
+            {
+                // A cancelled build is kept too, so a retry only fills the gaps
+                if (!cancelled.load() || (dataset->getDoneItems() > 0))
+                    datasetCache.insert(dataset);
+
+                if (!cancelled.load() && !loadedSnapshot)
+                    datasetCache.saveSnapshot(dataset);
+            }
+        }
+
+        // Problems writing earlier snapshots only surface here
+        const std::vector<std::string> snapshotWarnings = datasetCache.takeSnapshotWarnings();
+        warnings.insert(warnings.end(), snapshotWarnings.cbegin(), snapshotWarnings.cend());
+
+        if (numaReplicas && !lightMode && !hybridMode && !cancelled.load())
+            buildReplicas(cancelled);
+
+        if (cancelled.load())
+            warnings.push_back("RX initialization was cancelled.");
+        else if (lightMode || hybridMode)
+        {
+            for (size_t i = 0; i < hashCores.size(); i++)
+                vms.push_back(randomx_create_vm(flags, cache, nullptr));
+        }
+        else
+            createFullVMs(vms);
+
+        initTime.emplace(SECS(NOW - tic));
+    }
+
+    bool RxManager::hasRoomForDataset(u64 vmCount)
+    {
+        const u64 needed = RxDataset::getBytes() +
+            static_cast<u64>(RANDOMX_ARGON_MEMORY) * 1024 +
+            vmCount * static_cast<u64>(RANDOMX_SCRATCHPAD_L3);
+        const std::optional<u64> available = getAvailableMemory();
+
+        return !available.has_value() || (available.value() >= needed);
+    }
+
+    void RxManager::createFullVMs(std::vector<randomx_vm*>& out)
+    {
+        const NumaTopology topology = NumaTopology::detect();
+
+        for (size_t i = 0; i < hashCores.size(); i++)
+        {
+            const std::optional<u32> node = topology.nodeOf(hashCores[i]);
+            RxDataset* vmDataset = dataset.get();
+
+            if (node.has_value() && (node.value() < replicas.size()) &&
+                replicas[node.value()])
+                vmDataset = replicas[node.value()].get();
+
+            assert(vmDataset != nullptr);
+            out.push_back(randomx_create_vm(
+                flags | RANDOMX_FLAG_FULL_MEM, nullptr, vmDataset->get()));
         }
+    }
+
+    bool RxManager::completeDataset(const std::atomic<bool>& cancelled)
+    {
+        assert(hybridMode && fullVMs.empty());
+
+        RxDatasetCache& datasetCache = RxDatasetCache::instance();
 
-        const u32 datasetCount = randomx_dataset_item_count();
-        const u32 countPerThread = datasetCount / initThreads;
+        // The cache is only read, so the light-mode VMs can keep using it
+        buildDataset(cancelled);
 
+        if (cancelled.load())
+        {
+            // Keep what was built for the next job with this K
+            if (dataset->getDoneItems() > 0)
+                datasetCache.insert(dataset);
+
+            return false;
+        }
+
+        datasetCache.insert(dataset);
+        datasetCache.saveSnapshot(dataset);
+
+        if (numaReplicas)
+            buildReplicas(cancelled);
+
+        if (cancelled.load())
+            return false;
+
+        createFullVMs(fullVMs);
+        return true;
+    }
+
+    randomx_vm* RxManager::getFullVM(u32 tid)
+    {
+        assert(fullVMs.size() > 0);
+        return fullVMs.at(tid);
+    }
+
+    void RxManager::buildDataset(const std::atomic<bool>& cancelled)
+    {
+        const u32 initThreads = static_cast<u32>(initCores.size());
+
+        // Threads pull chunks as they go, so faster cores simply do more
+        std::atomic<unsigned long> nextChunk{0};
         std::vector<std::thread> threads;
 
-        for (u32 t = 0; t < (initThreads - 1); t++)
+        initStats.assign(initThreads, RxInitThreadStats());
+
+        for (u32 t = 0; t < initThreads; t++)
         {
-            const u32 thisStart = countPerThread * t;
+            initStats.at(t).core = initCores.at(t);
 
             threads.emplace_back(
-                rxInitDatasetWrapper, t, dataset, cache,
-                thisStart, countPerThread, std::cref(cancelled));
+                rxInitDatasetWrapper, std::ref(*dataset), cache,
+                std::ref(nextChunk), std::cref(cancelled), std::ref(initStats.at(t)));
 
             if (!setThreadAffinity(threads.back(), initCores.at(t)))
             {
@@ -954,60 +2211,234 @@ namespace wxpower
             }
         }
 
-        const u32 lastStart = countPerThread * (initThreads - 1);
-        const u32 lastCount = datasetCount - lastStart;
+        for (u32 t = 0; t < initThreads; t++)
+            threads.at(t).join();
+    }
+
+    // Copies `src` into `dst` with one thread per core, in chunks
+    static void copyDataset(
+        const RxDataset& src, const RxDataset& dst, const std::vector<u32>& cores,
+        const std::atomic<bool>& cancelled)
+    {
+        const u64 bytes = static_cast<u64>(randomx_dataset_item_count()) * RANDOMX_DATASET_ITEM_SIZE;
+        const u64 chunkBytes = static_cast<u64>(64) << 20;
+        const u8* const from = static_cast<const u8*>(randomx_get_dataset_memory(src.get()));
+        u8* const to = static_cast<u8*>(randomx_get_dataset_memory(dst.get()));
 
-        threads.emplace_back(
-            rxInitDatasetWrapper, initThreads - 1, dataset, cache,
-            lastStart, lastCount, std::cref(cancelled));
+        std::atomic<u64> next{0};
 
-        if (!setThreadAffinity(threads.back(), initCores.back()))
+        auto copyEntry = [&]()
         {
-            char temp[128];
+            for (u64 begin = next.fetch_add(chunkBytes); begin < bytes;
+                begin = next.fetch_add(chunkBytes))
+            {
+                if (cancelled.load())
+                    return;
+
+                memcpy(to + begin, from + begin, std::min(chunkBytes, bytes - begin));
+            }
+        };
 
-            snprintf(temp, 127, "Failed to set affinity for thread %"
-                PRIu32 " on core %" PRIu32,
-                initThreads - 1, initCores.back());
-            temp[127] = 0;
+        std::vector<std::thread> threads;
 
-            warnings.push_back(temp);
+        for (u32 core : cores)
+        {
+            threads.emplace_back(copyEntry);
+            setThreadAffinity(threads.back(), core);
         }
 
-        for (u32 t = 0; t < initThreads; t++)
-            threads.at(t).join();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
 
-        randomx_release_cache(cache);
-        cache = nullptr;
+    /* The NUMA node holding (nearly) all of `dataset`, asking the kernel
+       where a sample of its pages are. nullopt if it's spread over several
+       or the kernel can't say. */
+    static std::optional<u32> datasetNode(const RxDataset& dataset)
+    {
+#if defined(__linux__) && defined(SYS_move_pages)
+        const u64 bytes = static_cast<u64>(randomx_dataset_item_count()) * RANDOMX_DATASET_ITEM_SIZE;
+        const u64 pageBytes = static_cast<u64>(sysconf(_SC_PAGESIZE));
+        u8* const base = static_cast<u8*>(randomx_get_dataset_memory(dataset.get()));
 
-        if (cancelled.load())
-            warnings.push_back("RX initialization was cancelled.");
-        else
-            for (u32 i = 0; i < hashCores; i++)
-                vms.push_back(randomx_create_vm(flags, cache, dataset));
+        const size_t samples = 64;
+        std::vector<void*> pages(samples);
+        std::vector<int> status(samples, -1);
 
-        initTime.emplace(SECS(NOW - tic));
+        for (size_t i = 0; i < samples; i++)
+            pages[i] = base + (bytes / samples * i) / pageBytes * pageBytes;
+
+        // With no target nodes, `move_pages` only reports where pages are
+        if (syscall(SYS_move_pages, 0, static_cast<unsigned long>(samples), pages.data(),
+            nullptr, status.data(), 0) != 0)
+            return std::nullopt;
+
+        std::map<int, size_t> counts;
+
+        for (const int node : status)
+            if (node >= 0)
+                counts[node]++;
+
+        for (const std::pair<const int, size_t>& count : counts)
+            if (count.second >= (samples * 3 / 4))
+                return static_cast<u32>(count.first);
+#else
+        (void)dataset;
+#endif
+
+        return std::nullopt;
+    }
+
+    void RxManager::buildReplicas(const std::atomic<bool>& cancelled)
+    {
+        const NumaTopology topology = NumaTopology::detect();
+        u32 nodesWithCores = 0;
+
+        for (const std::vector<u32>& cores : topology.nodeCores)
+            if (!cores.empty())
+                nodesWithCores++;
+
+        if (nodesWithCores < 2)
+        {
+            warnings.push_back("Only one NUMA node found; not replicating the RX dataset.");
+            return;
+        }
+
+        /* The original can serve the node it's on. Failing the kernel's
+           word, a dataset built here by init cores on one node was first
+           touched there. */
+        std::optional<u32> originalNode = datasetNode(*dataset);
+
+        if (!originalNode.has_value() && !reusedDataset && !resumedItems.has_value() &&
+            !initCores.empty())
+        {
+            const std::optional<u32> firstNode = topology.nodeOf(initCores.front());
+
+            if (std::all_of(initCores.cbegin(), initCores.cend(),
+                [&](u32 core) { return topology.nodeOf(core) == firstNode; }))
+                originalNode = firstNode;
+        }
+
+        replicas.resize(topology.nodeCores.size());
+        std::vector<bool> tried(topology.nodeCores.size(), false);
+        bool allLocal = true;
+        bool originalUsed = false;
+
+        for (u32 hashCore : hashCores)
+        {
+            const std::optional<u32> node = topology.nodeOf(hashCore);
+
+            if (!node.has_value())
+            {
+                allLocal = false;
+                continue;
+            }
+
+            if (tried.at(node.value()))
+            {
+                allLocal = allLocal && replicas.at(node.value());
+                continue;
+            }
+
+            tried.at(node.value()) = true;
+
+            if (node == originalNode)
+            {
+                replicas.at(node.value()) = dataset;
+                originalUsed = true;
+                continue;
+            }
+
+            // Don't push the machine into swap for the sake of locality
+            const std::optional<u64> available = getAvailableMemory();
+            std::shared_ptr<RxDataset> replica;
+
+            if (!available.has_value() || (available.value() >= RxDataset::getBytes()))
+                replica = RxDataset::alloc(K, flags);
+
+            if (!replica)
+            {
+                char temp[128];
+
+                snprintf(temp, 127, "Failed to allocate an RX dataset replica "
+                    "for NUMA node %" PRIu32 "; its hash threads share one dataset.",
+                    node.value());
+                temp[127] = 0;
+
+                warnings.push_back(temp);
+                allLocal = false;
+                continue;
+            }
+
+            // The node's init cores do the copy, so its pages are first touched there
+            std::vector<u32> copyCores;
+
+            for (u32 core : initCores)
+                if (topology.nodeOf(core) == node)
+                    copyCores.push_back(core);
+
+            if (copyCores.empty())
+                copyCores.push_back(hashCore);
+
+            copyDataset(*dataset, *replica, copyCores, cancelled);
+
+            if (cancelled.load())
+                return;
+
+            replicas.at(node.value()) = replica;
+        }
+
+        // Hash threads won't use the original; keep it only if it's cached
+        if (allLocal && !originalUsed)
+        {
+            dataset.reset();
+            RxDatasetCache::instance().trim();
+        }
     }
 
-    RxManager::RxManager(bool useLargePages_, const Bigint& K_) :
-        proveMode(false), useLargePages(useLargePages_), K(K_), hashCores(1)
+    u32 RxManager::getReplicaCount() const
+    {
+        u32 ret = 0;
+
+        // The original serving its own node isn't a copy
+        for (const std::shared_ptr<RxDataset>& replica : replicas)
+            if (replica && (replica != dataset))
+                ret++;
+
+        return ret;
+    }
+
+    RxManager::RxManager(bool useLargePages_, const Bigint& K_, u32 vmCount) :
+        proveMode(false), useLargePages(useLargePages_), K(K_),
+        hashCores(std::max<u32>(vmCount, 1), 0)
     {
         const auto tic = NOW;
 
-        init();
-        vms.push_back(randomx_create_vm(flags, cache, dataset));
+        initFlags();
+
+        pooledCache = RxCachePool::instance().acquire(K, useLargePages, reusedCache);
+        cache = pooledCache->get();
+
+        for (size_t i = 0; i < hashCores.size(); i++)
+            vms.push_back(randomx_create_vm(flags, cache, nullptr));
 
         initTime.emplace(SECS(NOW - tic));
     }
 
-    void RxManager::init()
+    void RxManager::initFlags()
     {
         flags = randomx_get_flags();
 
-        if (proveMode)
+        if (proveMode && !lightMode && !hybridMode)
             flags |= RANDOMX_FLAG_FULL_MEM;
 
         if (useLargePages)
             flags |= RANDOMX_FLAG_LARGE_PAGES;
+    }
+
+    void RxManager::init()
+    {
+        initFlags();
 
         cache = randomx_alloc_cache(flags);
 
@@ -1027,12 +2458,14 @@ namespace wxpower
     RxManager::~RxManager()
     {
 #ifndef NDEBUG
-        if (proveMode)
+        if (proveMode && !lightMode && !hybridMode)
         {
             assert(cache == nullptr);
-            assert(dataset != nullptr);
+            assert((dataset != nullptr) || (getReplicaCount() > 0));
 
         }
+        else if (proveMode)
+            assert(cache != nullptr);
         else
         {
             assert(cache != nullptr);
@@ -1040,11 +2473,22 @@ namespace wxpower
         }
 #endif
 
-        if (dataset)
-            randomx_release_dataset(dataset);
+        for (randomx_vm* vm : vms)
+            randomx_destroy_vm(vm);
+
+        for (randomx_vm* vm : fullVMs)
+            randomx_destroy_vm(vm);
 
-        if (cache)
+        // A pooled cache goes back to the pool with `pooledCache`
+        if (cache && !pooledCache)
             randomx_release_cache(cache);
+
+        if (dataset)
+        {
+            // The cache may now drop this dataset if it's over budget
+            dataset.reset();
+            RxDatasetCache::instance().trim();
+        }
     }
 
     randomx_vm* RxManager::getVM(u32 tid)
@@ -1054,16 +2498,33 @@ namespace wxpower
     }
 
     void RxManager::rxInitDatasetWrapper(
-        u32 tid, randomx_dataset* dataset, randomx_cache* cache, unsigned long startItem,
-        unsigned long itemCount, const std::atomic<bool>& cancelled)
+        RxDataset& dataset, randomx_cache* cache,
+        std::atomic<unsigned long>& nextChunk, const std::atomic<bool>& cancelled,
+        RxInitThreadStats& stats)
     {
-        for (unsigned long i = startItem; i < (startItem + itemCount); i++)
+        const auto tic = NOW;
+        const unsigned long itemCount = randomx_dataset_item_count();
+        const unsigned long chunkItems = RxDataset::initChunkItems;
+
+        for (unsigned long chunk = nextChunk.fetch_add(1); !cancelled.load();
+            chunk = nextChunk.fetch_add(1))
         {
-            if ((i & 0xf) == (tid & 0xf))
-                if (cancelled.load())
-                    break;
+            const unsigned long startItem = chunk * chunkItems;
+
+            if (startItem >= itemCount)
+                break;
+
+            // Done by an earlier, cancelled build
+            if (dataset.isChunkDone(chunk))
+                continue;
 
-            randomx_init_dataset(dataset, cache, i, 1);
+            const unsigned long count = std::min(chunkItems, itemCount - startItem);
+
+            randomx_init_dataset(dataset.get(), cache, startItem, count);
+            dataset.markChunkDone(chunk);
+            stats.items += count;
         }
+
+        stats.seconds = SECS(NOW - tic);
     }
 }
@@ -0,0 +1,497 @@
+#ifndef _WIN32
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "power.hpp"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+namespace
+{
+    bool setNonBlocking(int fd)
+    {
+        const int flags = fcntl(fd, F_GETFL, 0);
+        return (flags >= 0) && (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0);
+    }
+
+    void setNoSigPipe(int fd)
+    {
+#ifdef SO_NOSIGPIPE
+        const int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#else
+        (void)fd;
+#endif
+    }
+
+    const char busyReply[] = "{\"status\":\"busy\"}";
+    const char tooLongReply[] = "{\"status\":\"invalid\",\"error\":\"Line too long.\"}";
+}
+
+namespace wxpower
+{
+    struct VerifyDaemon::Request
+    {
+        std::string proof;
+
+        // Written by a worker before `done` is set
+        std::string reply;
+        std::atomic<bool> done{false};
+
+        // The client went away, so there's no need to verify
+        std::atomic<bool> abandoned{false};
+    };
+
+    struct VerifyDaemon::Connection
+    {
+        int fd = -1;
+        std::string in;
+        std::string out;
+
+        // Replies are sent in request order, so finished ones may wait here
+        std::deque<std::shared_ptr<Request>> pending;
+
+        // Nothing more will be read; close once everything is sent
+        bool readClosed = false;
+        bool broken = false;
+    };
+
+    VerifyDaemon::VerifyDaemon(const Options& options_) :
+        options(options_)
+    {}
+
+    VerifyDaemon::~VerifyDaemon()
+    {
+        stop();
+    }
+
+    bool VerifyDaemon::start(std::string& error)
+    {
+        assert(!ioThread.joinable());
+
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+
+        if (options.socketPath.empty() || (options.socketPath.size() >= sizeof(addr.sun_path)))
+        {
+            error = "Bad socket path \"" + options.socketPath + "\".";
+            return false;
+        }
+
+        memcpy(addr.sun_path, options.socketPath.c_str(), options.socketPath.size());
+
+        // A socket file left by a server which died is replaced; a live one isn't
+        const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (probe >= 0)
+        {
+            const bool live = connect(
+                probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+            close(probe);
+
+            if (live)
+            {
+                error = "A server is already listening on \"" + options.socketPath + "\".";
+                return false;
+            }
+        }
+
+        unlink(options.socketPath.c_str());
+
+        const auto fail = [&](const std::string& what)
+        {
+            error = what + ": " + strerror(errno);
+
+            for (int* fd : { &listenFd, &wakeFds[0], &wakeFds[1] })
+            {
+                if (*fd >= 0)
+                    close(*fd);
+
+                *fd = -1;
+            }
+
+            return false;
+        };
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (listenFd < 0)
+            return fail("socket");
+
+        if (bind(listenFd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+            return fail("bind");
+
+        if ((listen(listenFd, SOMAXCONN) != 0) || !setNonBlocking(listenFd))
+            return fail("listen");
+
+        if ((pipe(wakeFds) != 0) || !setNonBlocking(wakeFds[0]) || !setNonBlocking(wakeFds[1]))
+            return fail("pipe");
+
+        stopping.store(false);
+        ioThread = std::thread(&VerifyDaemon::ioEntry, this);
+
+        for (u32 i = 0; i < std::max<u32>(options.workerCount, 1); i++)
+            workers.emplace_back(&VerifyDaemon::workerEntry, this);
+
+        return true;
+    }
+
+    void VerifyDaemon::stop()
+    {
+        if (!ioThread.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping.store(true);
+        }
+
+        queueChanged.notify_all();
+        wake();
+
+        ioThread.join();
+
+        for (std::thread& worker : workers)
+            worker.join();
+
+        workers.clear();
+        queue.clear();
+
+        close(listenFd);
+        close(wakeFds[0]);
+        close(wakeFds[1]);
+        listenFd = wakeFds[0] = wakeFds[1] = -1;
+
+        unlink(options.socketPath.c_str());
+    }
+
+    VerifyDaemon::Stats VerifyDaemon::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    void VerifyDaemon::wake()
+    {
+        const char c = 0;
+
+        // A full pipe already guarantees a wake-up
+        if (write(wakeFds[1], &c, 1) < 0)
+            return;
+    }
+
+    void VerifyDaemon::handleLine(Connection& conn, const std::string& line)
+    {
+        const std::shared_ptr<Request> request = std::make_shared<Request>();
+        conn.pending.push_back(request);
+
+        PowerV0::ProofView view;
+        const bool parsed = PowerV0::parseProof(line, view);
+
+        // Scope
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            stats.requests++;
+
+            // Answered here, so that it doesn't take a queue slot
+            if (!parsed)
+            {
+                request->reply = BatchVerifierV0::formatResult(BatchVerifierV0::Result());
+                request->done.store(true);
+
+                return;
+            }
+
+            if (queue.size() >= options.maxQueued)
+            {
+                stats.shed++;
+                request->reply = busyReply;
+                request->done.store(true);
+
+                return;
+            }
+
+            request->proof = line;
+            queue.push_back(request);
+        }
+
+        queueChanged.notify_one();
+    }
+
+    bool VerifyDaemon::isBackedUp(const Connection& conn) const
+    {
+        return (conn.pending.size() >= std::max<size_t>(options.maxPendingReplies, 1)) ||
+            (conn.out.size() >= options.maxUnsentBytes);
+    }
+
+    void VerifyDaemon::takeLines(Connection& conn)
+    {
+        size_t begin = 0;
+        bool tooLong = false;
+
+        // What's left stays in `in` until the client catches up
+        while (!isBackedUp(conn))
+        {
+            const size_t end = conn.in.find('\n', begin);
+
+            if (end == std::string::npos)
+                break;
+
+            if ((end - begin) > options.maxLineBytes)
+            {
+                tooLong = true;
+                break;
+            }
+
+            std::string line = conn.in.substr(begin, end - begin);
+            begin = end + 1;
+
+            if (!line.empty() && (line.back() == '\r'))
+                line.pop_back();
+
+            handleLine(conn, line);
+        }
+
+        conn.in.erase(0, begin);
+
+        const bool lineComplete = conn.in.find('\n') != std::string::npos;
+
+        // Also catches a line which is still arriving
+        if (tooLong || (!lineComplete && (conn.in.size() > options.maxLineBytes)))
+        {
+            const std::shared_ptr<Request> request = std::make_shared<Request>();
+
+            request->reply = tooLongReply;
+            request->done.store(true);
+            conn.pending.push_back(request);
+
+            conn.in.clear();
+            conn.readClosed = true;
+        }
+        else if (conn.readClosed && !lineComplete && !conn.in.empty() && !isBackedUp(conn))
+        {
+            // Last line, without a newline
+            handleLine(conn, conn.in);
+            conn.in.clear();
+        }
+    }
+
+    void VerifyDaemon::ioEntry()
+    {
+        std::vector<std::unique_ptr<Connection>> conns;
+        std::vector<pollfd> fds;
+        char buf[65536];
+
+        while (!stopping.load())
+        {
+            int timeout = -1;
+
+            fds.clear();
+            fds.push_back({ wakeFds[0], POLLIN, 0 });
+            fds.push_back({ listenFd, POLLIN, 0 });
+
+            for (const std::unique_ptr<Connection>& conn : conns)
+            {
+                short events = 0;
+
+                /* A client which sends faster than it reads its replies
+                   isn't read from until it catches up, nor while lines it
+                   already sent wait in `in`. */
+                if (!isBackedUp(*conn) && !conn->in.empty() &&
+                    (conn->readClosed || (conn->in.find('\n') != std::string::npos)))
+                    timeout = 0;
+                else if (!conn->readClosed && !isBackedUp(*conn))
+                    events |= POLLIN;
+
+                if (!conn->out.empty())
+                    events |= POLLOUT;
+
+                // Ignored, so that a hang-up can't spin the loop while it waits for workers
+                fds.push_back({ (events != 0) ? conn->fd : -1, events, 0 });
+            }
+
+            if (poll(fds.data(), fds.size(), timeout) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+
+                break;
+            }
+
+            if (fds[0].revents & POLLIN)
+                while (read(wakeFds[0], buf, sizeof(buf)) > 0);
+
+            // Only these were polled; accepted ones are read next time round
+            const size_t polled = conns.size();
+
+            if (fds[1].revents & POLLIN)
+            {
+                for (int fd = accept(listenFd, nullptr, nullptr); fd >= 0;
+                    fd = accept(listenFd, nullptr, nullptr))
+                {
+                    setNoSigPipe(fd);
+
+                    if ((conns.size() >= options.maxConnections) || !setNonBlocking(fd))
+                    {
+                        const std::string reply = std::string(busyReply) + '\n';
+
+                        send(fd, reply.c_str(), reply.size(), MSG_NOSIGNAL);
+                        close(fd);
+
+                        continue;
+                    }
+
+                    conns.push_back(std::make_unique<Connection>());
+                    conns.back()->fd = fd;
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stats.connections++;
+                }
+            }
+
+            for (size_t i = 0; i < polled; i++)
+            {
+                Connection& conn = *conns[i];
+
+                if (!(fds[2 + i].events & POLLIN) ||
+                    !(fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR)))
+                    continue;
+
+                // Never holds more than one line over the limit
+                while (conn.in.size() <= options.maxLineBytes)
+                {
+                    const ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+
+                    if (n > 0)
+                        conn.in.append(buf, n);
+                    else
+                    {
+                        if ((n == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+                            conn.readClosed = true;
+
+                        break;
+                    }
+                }
+            }
+
+            for (const std::unique_ptr<Connection>& conn : conns)
+            {
+                if (!conn->in.empty())
+                    takeLines(*conn);
+
+                while (!conn->pending.empty() && conn->pending.front()->done.load())
+                {
+                    conn->out += conn->pending.front()->reply;
+                    conn->out += '\n';
+                    conn->pending.pop_front();
+                }
+
+                if (!conn->out.empty())
+                {
+                    const ssize_t n = send(
+                        conn->fd, conn->out.c_str(), conn->out.size(), MSG_NOSIGNAL);
+
+                    if (n > 0)
+                        conn->out.erase(0, n);
+                    else if ((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+                        conn->broken = true;
+                }
+            }
+
+            for (size_t i = 0; i < conns.size();)
+            {
+                Connection& conn = *conns[i];
+
+                if (conn.broken || (conn.readClosed &&
+                    conn.in.empty() && conn.pending.empty() && conn.out.empty()))
+                {
+                    for (const std::shared_ptr<Request>& request : conn.pending)
+                        request->abandoned.store(true);
+
+                    close(conn.fd);
+                    conns.erase(conns.begin() + i);
+                }
+                else
+                    i++;
+            }
+        }
+
+        for (const std::unique_ptr<Connection>& conn : conns)
+        {
+            for (const std::shared_ptr<Request>& request : conn->pending)
+                request->abandoned.store(true);
+
+            close(conn->fd);
+        }
+    }
+
+    void VerifyDaemon::workerEntry()
+    {
+        BatchVerifierV0 batch(options.useLargePages, options.threadsPerWorker);
+
+        for (;;)
+        {
+            std::vector<std::shared_ptr<Request>> taken;
+
+            // Scope
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                queueChanged.wait(lock, [this]() { return stopping.load() || !queue.empty(); });
+
+                if (stopping.load())
+                    return;
+
+                while (!queue.empty() && (taken.size() < std::max<size_t>(options.maxBatch, 1)))
+                {
+                    if (!queue.front()->abandoned.load())
+                        taken.push_back(queue.front());
+
+                    queue.pop_front();
+                }
+            }
+
+            if (taken.empty())
+                continue;
+
+            std::vector<std::string> proofs;
+            std::atomic<size_t> done{0};
+
+            for (const std::shared_ptr<Request>& request : taken)
+                proofs.push_back(request->proof);
+
+            // Stopping cancels the batch
+            const std::vector<BatchVerifierV0::Result> results =
+                batch.verify(proofs, stopping, done);
+
+            for (size_t i = 0; i < taken.size(); i++)
+            {
+                taken[i]->reply = BatchVerifierV0::formatResult(results[i]);
+                taken[i]->done.store(true);
+            }
+
+            // Scope
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stats.verified += taken.size();
+            }
+
+            wake();
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include <cstring>
+
+#include <algorithm>
+
+#include "power.hpp"
+#include "simd.hpp"
+
+namespace wxpower
+{
+    ProofExtractorV0::Delimiter ProofExtractorV0::separatedBy(std::string separator)
+    {
+        return [separator](std::string_view doc, size_t from, size_t magicPos)
+        {
+            // No separator means one record
+            if (separator.empty())
+                return std::make_pair(from, doc.size());
+
+            /* Forwards from the last record rather than back from the
+               magic sequence: `find` is memchr-based, `rfind` bytewise. */
+            const std::string_view before = doc.substr(0, magicPos);
+            size_t begin = from;
+
+            for (size_t sep = before.find(separator, from); sep != std::string_view::npos;
+                sep = before.find(separator, begin))
+                begin = sep + separator.size();
+
+            const size_t after = doc.find(separator, magicPos + PowerV0::magicSequence.size());
+
+            return std::make_pair(begin, (after == std::string_view::npos) ? doc.size() : after);
+        };
+    }
+
+    ProofExtractorV0::ProofExtractorV0(Delimiter delimiter_) :
+        delimiter(std::move(delimiter_))
+    {}
+
+    std::vector<std::string_view> ProofExtractorV0::extract(std::string_view doc) const
+    {
+        std::vector<std::string_view> ret;
+        size_t from = 0;
+
+        for (const size_t pos : findMagic(doc))
+        {
+            // Already part of the last record
+            if (pos < from)
+                continue;
+
+            const std::pair<size_t, size_t> record = delimiter(doc, from, pos);
+
+            assert(record.first >= from);
+            assert(record.first <= pos);
+            assert(record.second >= (pos + PowerV0::magicSequence.size()));
+            assert(record.second <= doc.size());
+
+            ret.push_back(doc.substr(record.first, record.second - record.first));
+            from = record.second;
+        }
+
+        return ret;
+    }
+
+    std::vector<size_t> ProofExtractorV0::findMagic(std::string_view doc)
+    {
+        const std::string& magic = PowerV0::magicSequence;
+        const size_t len = magic.size();
+        std::vector<size_t> ret;
+        size_t pos = 0;
+
+#ifdef WXPOWER_SSE2
+        /* Candidates are where both the first and the last byte of the
+           magic sequence match, 16 positions at a time; only those are
+           compared in full. */
+        const __m128i first = _mm_set1_epi8(magic.front());
+        const __m128i last = _mm_set1_epi8(magic.back());
+
+        for (; (pos + 16 + len - 1) <= doc.size(); pos += 16)
+        {
+            const __m128i a = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(doc.data() + pos));
+            const __m128i b = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(doc.data() + pos + len - 1));
+
+            u32 mask = static_cast<u32>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+
+            while (mask != 0)
+            {
+                const size_t candidate = pos + countTrailingZeros32(mask);
+
+                if (memcmp(doc.data() + candidate + 1, magic.data() + 1, len - 2) == 0)
+                    ret.push_back(candidate);
+
+                mask &= mask - 1;
+            }
+        }
+#endif
+
+        for (pos = doc.find(magic, pos); pos != std::string_view::npos;
+            pos = doc.find(magic, pos + 1))
+            ret.push_back(pos);
+
+        return ret;
+    }
+}
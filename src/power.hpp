@@ -6,9 +6,14 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -57,6 +62,10 @@ namespace wxpower
         const u8* getBytes() const;
         std::string toString() const;
 
+        /* Parses 64 hex digits (either case). Returns false on bad input,
+           leaving `out` unchanged. */
+        static bool fromString(const std::string& str, Bigint& out);
+
     private:
         u8 buf[32];
     };
@@ -69,17 +78,91 @@ namespace wxpower
         Base64(u64 val);
         Base64(u32 val);
 
-        void incr();
+        /* Returns the number of leading digits (in printed order) which
+           were changed, i.e. how many characters need rewriting in any
+           copy of the printed form. */
+        u32 incr();
+        u32 size() const;
+
+        /* Prints the first `count` digits to `out` (no terminator). */
+        void write(char* out, u32 count) const;
         std::string toString() const;
 
         static const std::vector<char> mapping;
+        static const u32 maxSize = 64;
 
     private:
-        static const u32 maxSize = 64;
         u8 buf[maxSize];
         u32 len = 1;
     };
 
+    /* Hash input of the form `body|seed|ctr` in a buffer allocated once.
+       Incrementing the counter only rewrites the digits that changed, so the
+       prover loop can hash without touching the heap. */
+    class NonceInput
+    {
+    public:
+        NonceInput(const std::string& body, const Base64& seed_ = Base64(),
+            const Base64& ctr_ = Base64());
+
+        void incr();
+        void set(const Base64& seed_, const Base64& ctr_);
+
+        const char* data() const;
+        size_t size() const;
+        const Base64& getSeed() const;
+        const Base64& getCtr() const;
+
+    private:
+        std::vector<char> buf;
+        const size_t seedPos;
+        size_t ctrPos = 0;
+        Base64 seed;
+        Base64 ctr;
+    };
+
+    /* Hands out a prove job's nonce space in fixed-size blocks, so that hash
+       threads pull work at their own pace. Fresh blocks come from a single
+       atomic cursor. Ranges given back by threads which stop part-way
+       through a block are handed out again before any fresh block. */
+    class NonceScheduler
+    {
+    public:
+        // Nonces [begin, end)
+        struct Range
+        {
+            u64 begin = 0;
+            u64 end = 0;
+
+            bool empty() const
+            {
+                return begin >= end;
+            }
+        };
+
+        NonceScheduler(u64 blockSize_, u64 firstNonce = 0);
+
+        Range take();
+        void giveBack(const Range& range);
+
+        // Start of the first block never handed out
+        u64 getCursor() const;
+        std::vector<Range> getReturned() const;
+
+        /* Restores saved progress. Only valid before any `take`. */
+        void reset(u64 cursor_, const std::vector<Range>& returned_);
+
+        const u64 blockSize;
+
+    private:
+        std::atomic<u64> cursor;
+
+        // Fast check so `take` only locks when there's something to take
+        std::atomic<bool> hasReturned;
+        mutable std::mutex returnedMutex;
+        std::vector<Range> returned;
+    };
+
     /* Class to access SHA256. On Windows, uses built-in 'Bcrypt.lib' funcs to
     * minimise dependencies. If you're on Linux then it requires 'openssl-dev',
     * but you don't need me to tell you that :). */
@@ -105,6 +188,40 @@ namespace wxpower
 
     bool setThreadAffinity(std::thread& thread, u32 core);
 
+    /* Which logical cores belong to which NUMA node. A machine without
+       NUMA (or where it can't be detected) has a single node holding every
+       core. */
+    class NumaTopology
+    {
+    public:
+        static NumaTopology detect();
+
+        // Index into `nodeCores`, or nullopt if `core` isn't listed
+        std::optional<u32> nodeOf(u32 core) const;
+
+        // Parses a sysfs cpu list such as "0-3,8-11"; nullopt if malformed
+        static std::optional<std::vector<u32>> parseCpuList(const std::string& list);
+
+        std::vector<std::vector<u32>> nodeCores;
+    };
+
+    /* Physical memory this process could still allocate, taking container
+       (cgroup) limits into account where known. */
+    std::optional<u64> getAvailableMemory();
+
+    /* Escapes `str` for use inside a JSON string (quotes not included).
+       Bytes from 0x80 up are passed through, so UTF-8 input stays UTF-8. */
+    std::string jsonEscape(const std::string& str);
+
+    /* Undoes the escaping used for proofs with line breaks in line-based
+       files: "\\n", "\\r" and "\\\\" become a newline, a carriage return
+       and a backslash. Any other backslash is kept as is. */
+    std::string unescapeLine(const std::string& line);
+
+    /* Parses a non-negative decimal number, as the command line tools take
+       counts. Fails on anything else, including values above `max`. */
+    bool parseCount(const char* str, u64& out, u64 max = UINT64_MAX);
+
     struct HashResult
     {
         std::string proof;
@@ -144,6 +261,25 @@ namespace wxpower
             std::string context;
         };
 
+        /* A parsed proof which borrows from the message it came from. A
+           field holding escapes is unescaped into its `...Storage` member
+           and points there instead, so views are neither copied nor moved. */
+        struct ProofView
+        {
+            std::string_view body;
+            std::string_view userId;
+            std::string_view context;
+
+            std::string userIdStorage;
+            std::string contextStorage;
+
+            ProofView() = default;
+            ProofView(const ProofView&) = delete;
+            ProofView& operator=(const ProofView&) = delete;
+
+            ProofContent toContent() const;
+        };
+
         virtual ~PowerV0() = default;
 
         /* Returns true if a message was parsed with this API version
@@ -162,16 +298,37 @@ namespace wxpower
         /* Calculate "left zeroes count" difficulty. */
         static u32 calcLZCDiff(const Bigint& bigint);
 
+        /* Equivalent to `calcLZCDiff(bigint) > diff`, but usually decided by
+           the first byte alone. */
+        static bool isLZCDiffAbove(const Bigint& bigint, u32 diff);
+
+        /* Scores `count` hashes into `out` (which must hold `count` items). */
+        static void calcLZCDiffs(const Bigint* bigints, size_t count, u32* out);
+
         /* Concatenates info into the metadata string. (This is hashed with
            SHA256 and used as the RX K input.) */
         static std::string contentToMetaData(
             const PowerV0::ProofContent& content);
+        static std::string contentToMetaData(const ProofView& view);
 
-        static s32 utf8CharsToSkip(const std::string& str, s32 pos);
+        /* The body, user ID and context, laid out for display. */
+        static std::string contentToPrettyMetaData(
+            const PowerV0::ProofContent& content);
+        static std::string contentToPrettyMetaData(const ProofView& view);
+
+        static s32 utf8CharsToSkip(std::string_view str, s32 pos);
 
         /* Removes non-printable characters from the input string. */
         static void trimBody(std::string& body);
 
+        /* `trimBody` without the copy: the trimmed part of `body`. */
+        static std::string_view trimmedBody(std::string_view body);
+
+        /* Same result as `trimBody` then `msgToContent`, in one pass and
+           without copying unless a field holds escapes. `out` points into
+           `msg`, which must outlive it. */
+        static bool parseProof(std::string_view msg, ProofView& out);
+
         static const std::string magicSequence;
         static const std::vector<char> skippable1;
         static const std::vector<std::string> skippable2;
@@ -188,6 +345,84 @@ namespace wxpower
         std::chrono::system_clock, std::chrono::duration<
         double, std::chrono::system_clock::period>>;
 
+    /* Snapshot of a v0 prove job's progress: everything needed to resume it
+       later without repeating nonces which were already searched. */
+    struct ProveV0Checkpoint
+    {
+        PowerV0::ProofContent content;
+        Bigint K;
+        u64 blockSize = 0;
+
+        /* Unsearched nonces are `[cursor, inf)` plus the `pending` ranges. */
+        u64 cursor = 0;
+        std::vector<NonceScheduler::Range> pending;
+
+        u64 hashes = 0;
+        HashResult best;
+
+        bool save(const std::string& path, std::string& error) const;
+        bool load(const std::string& path, std::string& error);
+
+        /* Suggested file name, unique to the body and metadata. */
+        static std::string fileNameFor(const PowerV0::ProofContent& content);
+    };
+
+    /* How proving runs RX. Full mode hashes against the 2 GiB dataset;
+       light mode against the 256 MiB cache only, which is several times
+       slower but fits on small machines. Automatic picks full mode if there
+       appears to be enough free memory and falls back to light mode if the
+       dataset can't be allocated. Hybrid starts hashing in light mode right
+       away while the dataset is built alongside, then switches the hash
+       threads over to full mode. */
+    enum class RxMode
+    {
+        full,
+        light,
+        automatic,
+        hybrid
+    };
+
+    /* Work done by one RX dataset init thread. */
+    struct RxInitThreadStats
+    {
+        u32 core = 0;
+        u64 items = 0;
+        double seconds = 0.0;
+    };
+
+    /* Tuning knobs for a v0 prove job which don't change the proof. */
+    struct ProveV0Options
+    {
+        /* Use RX's `randomx_calculate_hash_first/next/last` API, overlapping
+           the start of each hash with the end of the previous one. Off until
+           `BM_HashLight`/`BM_HashFull` show it's faster; see the README. */
+        bool pipelined = false;
+
+        /* Nonces per unit of work handed to a hash thread. Each block is
+           proved as `body|<block>|<offset>`. */
+        u64 nonceBlockSize = 1024;
+
+        /* If set, progress is saved here every `checkpointInterval` seconds
+           and when hashing stops, whether cancelled or finished. A job
+           whose content matches the file resumes from it instead of
+           starting at nonce zero, so a finished proof can be mined further
+           toward a higher difficulty. */
+        std::string checkpointPath;
+        double checkpointInterval = 60.0;
+
+        /* The checkpoint holds the body in plain text. With this, it's
+           deleted once the job finishes (but still kept on cancel). */
+        bool deleteCheckpointOnFinish = false;
+
+        RxMode rxMode = RxMode::automatic;
+
+        /* On NUMA machines, give each node with hash cores its own copy of
+           the dataset, so that hash threads only read node-local memory.
+           The node already holding the dataset uses it as is; every other
+           node costs one extra dataset's worth of memory, if free. */
+        bool numaReplicas = false;
+    };
+
     class ProveV0Manager
     {
     public:
@@ -219,21 +454,54 @@ namespace wxpower
             std::string errorStr;
             std::vector<std::string> warnings;
 
+            // Hashes done by earlier runs, if resumed from a checkpoint
+            std::optional<u64> resumedHashes;
+
             std::optional<double> rxTime;
+
+            // RX dataset was reused from an earlier job with the same K
+            bool rxReused = false;
+
+            // RX dataset was loaded from an on-disk snapshot
+            bool rxFromSnapshot = false;
+
+            /* Effective mode once RX is initialized; never `automatic`.
+               `hybrid` turns into `full` once the hash threads switch. */
+            std::optional<RxMode> rxMode;
+
+            // Hybrid mode: hashing time before full-mode VMs were handed out
+            std::optional<double> rxDatasetTime;
+
+            // Per-NUMA-node dataset copies in use, 0 if not replicating
+            u32 rxReplicas = 0;
+
+            // One entry per init thread if the dataset was built
+            std::vector<RxInitThreadStats> rxInitStats;
+
+            // Dataset items kept from an earlier, cancelled build
+            std::optional<u64> rxResumedItems;
             std::optional<NowTime> hashStartTime;
             std::optional<NowTime> hashStopTime;
 
-            /* `bestResults` only updated when threads quit. Read `bestDiff` to
-               see progress during runtime. */
+            /* `bestResults` only updated when threads pause or quit. Read
+               `bestDiff` to see progress during runtime. */
             std::vector<HashResult> bestResults;
         };
 
-        struct ThreadGuarded
+        /* Members written by one hash thread and read by anyone. Each block
+           fills its own cache line, so the periodic progress stores of
+           neighbouring threads never contend. */
+        struct alignas(64) ThreadGuarded
         {
-            std::vector<std::atomic<u32>*> bestDiff;
-            std::vector<std::atomic<u64>*> hashes;
+            std::atomic<u32> bestDiff{ 0 };
+            std::atomic<u64> hashes{ 0 };
+
+            // Set once in hybrid mode; the thread switches at its next poll
+            std::atomic<randomx_vm*> nextVM{ nullptr };
         };
 
+        static_assert(sizeof(ThreadGuarded) == 64, "ThreadGuarded must fill one cache line");
+
         struct ThreadGuardedRet
         {
             std::vector<u32> bestDiff;
@@ -246,13 +514,20 @@ namespace wxpower
             const std::vector<u32>& hashCores_,
             bool useLargePages_,
             const std::optional<u32>& diff_,
-            const std::optional<double>& timeLimit_);
+            const std::optional<double>& timeLimit_,
+            const ProveV0Options& options_ = ProveV0Options());
 
         ~ProveV0Manager();
 
         void cancel();
         bool isCancelled() const;
 
+        /* Sets how many of the job's hash threads should run. Threads
+           `count` and above give back the rest of their nonce block and
+           park until they are wanted again, without restarting RX. */
+        void setActiveThreads(u32 count);
+        u32 getActiveThreads() const;
+
         MasterGuarded getMasterGuardedData();
         ThreadGuardedRet getThreadGuardedData() const;
         State getState() const;
@@ -263,11 +538,23 @@ namespace wxpower
         const bool useLargePages;
         const std::optional<u32> diff;
         const std::optional<double> timeLimit;
+        const ProveV0Options options;
         const u32 hashThreadCount;
 
     private:
         static void threadEntry(ProveV0Manager* state);
-        static void hashThreadEntry(ProveV0Manager* mgr, u32 tid, randomx_vm* const vm);
+        static void hashThreadEntry(ProveV0Manager* mgr, u32 tid, randomx_vm* vm);
+
+        /* Loads `options.checkpointPath` into the scheduler if it matches
+           this job. Must be called before hashing starts. */
+        std::optional<ProveV0Checkpoint> loadCheckpoint(const Bigint& K);
+
+        /* If `pauseThreads`, hash threads briefly give back their blocks so
+           the snapshot is exact. */
+        void saveCheckpoint(const Bigint& K, bool pauseThreads);
+
+        // Wakes parked hash threads to re-check whether they should run
+        void wakeHashThreads();
 
         std::optional<std::thread> master;
         std::mutex masterMutex;
@@ -279,17 +566,268 @@ namespace wxpower
         /* Has the GUI requested to cancel? */
         std::atomic<bool> cancelled;
 
+        /* Hash threads with `tid >= activeThreads` are parked. */
+        std::atomic<u32> activeThreads;
+
+        /* While set, hash threads give back their blocks and wait, so that
+           `threadsHolding` drops to zero for a consistent checkpoint. Parked
+           threads and a pausing master wait on `pauseCond`, which is
+           signalled whenever a thread lets go of its block or the flags
+           above change. */
+        std::atomic<bool> pauseRequested;
+        std::mutex pauseMutex;
+        std::condition_variable pauseCond;
+
+        // Guarded by `pauseMutex`
+        u32 threadsHolding = 0;
+
+        NonceScheduler scheduler;
+
         std::vector<std::thread> hashThreads;
 
         // Members that are guarded by `masterMutex`
         MasterGuarded masterGuarded;
 
-        // Members that are thread-specific
-        ThreadGuarded threadGuarded;
+        // Members that are thread-specific, one per hash thread
+        const std::unique_ptr<ThreadGuarded[]> threadGuarded;
 
         std::atomic<State> state;
     };
 
+    /* One RX dataset for a given K. Shared between prove jobs through
+       `RxDatasetCache`; holders of the `shared_ptr` (i.e. `RxManager`s with
+       VMs using it) keep it alive.
+
+       Initialization is tracked in chunks of `initChunkItems` items, so a
+       build that was cancelled part-way can later be finished. Only the
+       thread that initialized a chunk marks it. */
+    class RxDataset
+    {
+    public:
+        // Returns nullptr if the allocation fails
+        static std::shared_ptr<RxDataset> alloc(const Bigint& K, randomx_flags flags);
+
+        ~RxDataset();
+
+        randomx_dataset* get() const;
+
+        // Memory used by one dataset
+        static u64 getBytes();
+
+        // Dataset items per unit of init work
+        static constexpr unsigned long initChunkItems = 4096;
+        static u64 getChunkCount();
+
+        bool isChunkDone(u64 chunk) const;
+        void markChunkDone(u64 chunk);
+        void markAllDone();
+
+        bool isComplete() const;
+        u64 getDoneItems() const;
+
+        const Bigint K;
+
+    private:
+        RxDataset(const Bigint& K_, randomx_dataset* dataset_);
+
+        randomx_dataset* const dataset;
+
+        // One flag per chunk; bytes so that threads never share an element
+        std::vector<u8> doneChunks;
+    };
+
+    /* Process-wide cache of finished datasets keyed by K, so that repeat
+       proves with the same metadata skip RX initialization. Least recently
+       used datasets are dropped to stay within the memory budget, but only
+       once no job is using them. */
+    class RxDatasetCache
+    {
+    public:
+        static RxDatasetCache& instance();
+
+        /* Returns nullptr on a miss. A partially built dataset is removed
+           from the cache and handed to this caller alone, to finish and
+           `insert` again. */
+        std::shared_ptr<RxDataset> acquire(const Bigint& K);
+
+        // A finished dataset for `K` is held (it may be in use)
+        bool contains(const Bigint& K) const;
+        void insert(const std::shared_ptr<RxDataset>& dataset);
+
+        /* Drops unused datasets until `bytes` more would fit in the budget
+           (or nothing more can be dropped). */
+        void makeRoom(u64 bytes);
+        void trim();
+
+        void setBudget(u64 bytes);
+        u64 getBudget() const;
+        u64 getUsedBytes() const;
+
+        // Defaults to keeping one dataset
+        static u64 defaultBudget();
+
+        /* Finished datasets can also be kept on disk, one snapshot file per
+           K in `dir`, so that a later run copies the dataset back in rather
+           than initializing it. Least recently used snapshots are deleted to
+           stay within `maxBytes`. An empty `dir` disables snapshots. */
+        void setSnapshotDir(const std::string& dir, u64 maxBytes);
+
+        /* Fills `dataset` from its snapshot with one thread per entry of
+           `cores`. Returns false if there is no usable snapshot (a corrupt
+           one is deleted) or on cancellation. */
+        bool loadSnapshot(
+            RxDataset& dataset, const std::vector<u32>& cores,
+            const std::atomic<bool>& cancelled, std::vector<std::string>& warnings);
+
+        /* Writes a snapshot of a finished dataset on a background thread,
+           unless snapshots are disabled or one already exists. */
+        void saveSnapshot(const std::shared_ptr<RxDataset>& dataset);
+
+        // Problems hit by background writes since the last call
+        std::vector<std::string> takeSnapshotWarnings();
+
+        static std::string snapshotFileName(const Bigint& K);
+
+        // Snapshot file size, including the header
+        static u64 getSnapshotBytes();
+
+        /* The file level of the above, for `dataBytes` of dataset memory (a
+           multiple of 32) so that it works without a full dataset.
+           `readSnapshotFile` checks the file against `K` while copying its
+           data to `dst`, with one thread per entry of `cores`. On failure
+           `problem` says what's wrong with the file; it is empty if
+           `cancelled` was set. */
+        static bool readSnapshotFile(
+            const std::string& path, const Bigint& K, void* dst, u64 dataBytes,
+            const std::vector<u32>& cores, const std::atomic<bool>& cancelled,
+            std::string& problem);
+
+        // Goes through a temporary file, so a partial write never has the name
+        static bool writeSnapshotFile(
+            const std::string& path, const Bigint& K, const void* src, u64 dataBytes,
+            std::string& error);
+
+        /* Deletes the least recently modified snapshots in `dir` until
+           `incomingBytes` more fit in `maxBytes`. Returns whether they do. */
+        static bool evictSnapshots(const std::string& dir, u64 incomingBytes, u64 maxBytes);
+
+    private:
+        RxDatasetCache();
+        ~RxDatasetCache();
+
+        void makeRoomLocked(u64 bytes);
+
+        void writeSnapshot(std::shared_ptr<RxDataset> dataset, std::string dir, u64 maxBytes);
+
+        mutable std::mutex mutex;
+        u64 budget;
+
+        // Most recently used at the back
+        std::vector<std::shared_ptr<RxDataset>> entries;
+
+        // Snapshot settings, guarded by `mutex`
+        std::string snapshotDir;
+        u64 snapshotMaxBytes = 0;
+        std::vector<std::string> snapshotWarnings;
+
+        // Serializes `saveSnapshot` callers; the writer only takes `mutex`
+        std::mutex writerMutex;
+        std::thread snapshotWriter;
+    };
+
+    /* An RX cache initialized for one K, lent out by `RxCachePool`. */
+    class RxCache
+    {
+    public:
+        ~RxCache();
+
+        randomx_cache* get() const;
+        const Bigint& getK() const;
+
+        // Seconds initialization took
+        double getInitTime() const;
+
+        // Memory used by one cache
+        static u64 getBytes();
+
+    private:
+        friend class RxCachePool;
+
+        RxCache(randomx_cache* cache_, randomx_flags allocFlags_);
+
+        randomx_cache* const cache;
+        const randomx_flags allocFlags;
+
+        // Set by the pool; a recycled cache gets a new K
+        Bigint K;
+        double initTime = 0;
+        bool ready = false;
+    };
+
+    /* Process-wide pool of RX caches keyed by K, for verification. A cache
+       stays pinned while anyone holds it. Unpinned caches are kept for
+       later hits, least recently used first out; the pool never holds more
+       than its byte budget, so `acquire` waits if everything is pinned. A
+       cache pushed out for a new K is reinitialized in place rather than
+       freed, keeping its (possibly large page) memory. */
+    class RxCachePool
+    {
+    public:
+        struct Stats
+        {
+            u64 hits = 0;
+            u64 misses = 0;
+
+            // Caches dropped for another K, whether freed or reinitialized
+            u64 evictions = 0;
+            u64 recycled = 0;
+
+            // Init time hits didn't have to spend again
+            double initSecondsSaved = 0;
+
+            double getHitRate() const;
+        };
+
+        static RxCachePool& instance();
+
+        /* Returns a cache initialized for `K`. A K already being initialized
+           by another caller is waited for rather than done twice. If the
+           budget is below one cache, nothing is pooled and every call gets
+           a cache of its own. `hit` says whether it was already
+           initialized. Throws `RxManager::Exception` if allocation fails. */
+        std::shared_ptr<RxCache> acquire(const Bigint& K, bool useLargePages, bool& hit);
+
+        void setBudget(u64 bytes);
+        u64 getBudget() const;
+        u64 getUsedBytes() const;
+
+        // Caches the budget has room for; 0 if pooling is off
+        u32 getCapacity() const;
+
+        // Defaults to two caches
+        static u64 defaultBudget();
+
+        Stats getStats() const;
+        void resetStats();
+
+    private:
+        RxCachePool();
+
+        // Drops a holder's pin on `entry`
+        void release(std::shared_ptr<RxCache>& entry);
+        void trimLocked();
+        u32 capacityLocked() const;
+
+        mutable std::mutex mutex;
+        std::condition_variable released;
+        u64 budget;
+
+        // Most recently used at the back
+        std::vector<std::shared_ptr<RxCache>> entries;
+
+        Stats stats;
+    };
+
     class RxManager
     {
     public:
@@ -308,11 +846,13 @@ namespace wxpower
         // Proving
         RxManager(
             bool useLargePages_, const Bigint& K_,
-            const std::vector<u32>& initCores_, u32 hashCores_,
-            const std::atomic<bool>& cancelled_);
+            const std::vector<u32>& initCores_, const std::vector<u32>& hashCores_,
+            const std::atomic<bool>& cancelled_, RxMode mode = RxMode::full,
+            bool numaReplicas_ = false);
 
-        // Verification
-        RxManager(bool useLargePages_, const Bigint& K_);
+        /* Verification. All `vmCount` VMs share the one cache, which comes
+           from `RxCachePool`. */
+        RxManager(bool useLargePages_, const Bigint& K_, u32 vmCount = 1);
 
         virtual ~RxManager();
 
@@ -321,22 +861,505 @@ namespace wxpower
         std::vector<std::string> warnings;
         std::optional<double> initTime;
 
+        // Dataset was taken from `RxDatasetCache` rather than built
+        bool reusedDataset = false;
+
+        // Dataset was copied in from an on-disk snapshot rather than built
+        bool loadedSnapshot = false;
+
+        // Verification: the cache was already initialized in the pool
+        bool reusedCache = false;
+
+        // Proving VMs run against the cache; there is no dataset
+        bool lightMode = false;
+
+        /* `getVM` returns light-mode VMs, and the dataset is still to be
+           built by `completeDataset`. */
+        bool hybridMode = false;
+
+        // One entry per init thread if the dataset was built
+        std::vector<RxInitThreadStats> initStats;
+
+        // Items already done by an earlier, cancelled build that was resumed
+        std::optional<u64> resumedItems;
+
+        // VM `tid` is the one for `hashCores[tid]`
         randomx_vm* getVM(u32 tid);
 
+        /* Hybrid mode: builds the dataset and full-mode VMs, while the
+           light-mode VMs may keep hashing. Returns false if cancelled. */
+        bool completeDataset(const std::atomic<bool>& cancelled);
+        randomx_vm* getFullVM(u32 tid);
+
+        // Node-local dataset copies, see `ProveV0Options::numaReplicas`
+        u32 getReplicaCount() const;
+
+        /* False if free memory is known to be short of building a dataset
+           now: the dataset, the cache it's built from and `vmCount` VMs'
+           scratchpads. Automatic and hybrid modes use light mode then. */
+        static bool hasRoomForDataset(u64 vmCount);
+
     private:
+        void initFlags();
+        void buildDataset(const std::atomic<bool>& cancelled);
+        void buildReplicas(const std::atomic<bool>& cancelled);
+        void createFullVMs(std::vector<randomx_vm*>& out);
+
+        /* Initializes chunks taken from `nextChunk` until there are none
+           left or init is cancelled. */
         static void rxInitDatasetWrapper(
-            u32 tid, randomx_dataset* dataset, randomx_cache* cache, unsigned long startItem,
-            unsigned long itemCount, const std::atomic<bool>& cancelled);
+            RxDataset& dataset, randomx_cache* cache,
+            std::atomic<unsigned long>& nextChunk, const std::atomic<bool>& cancelled,
+            RxInitThreadStats& stats);
 
         const bool proveMode;
         const bool useLargePages;
         const Bigint K;
         const std::vector<u32> initCores;
-        const u32 hashCores;
+        const std::vector<u32> hashCores;
+        const bool numaReplicas = false;
 
         randomx_flags flags;
         randomx_cache* cache = nullptr;
-        randomx_dataset* dataset = nullptr;
+        std::shared_ptr<RxDataset> dataset;
+
+        // Verification: owns `cache`, which is then not released here
+        std::shared_ptr<RxCache> pooledCache;
+
+        /* Indexed by NUMA node; nullptr for nodes without hash cores. The
+           node holding `dataset` gets `dataset` itself. */
+        std::vector<std::shared_ptr<RxDataset>> replicas;
+
         std::vector<randomx_vm*> vms;
+
+        // Hybrid mode only
+        std::vector<randomx_vm*> fullVMs;
     };
+
+    /* Builds (or loads) the RX dataset for one K on a background thread and
+       leaves it in `RxDatasetCache`, so that a prove job with that K
+       started later finds it ready. If cancelled, the partial dataset is
+       cached and the job finishes it. `mode` must be full or automatic;
+       the others don't build a dataset up front. */
+    class RxPrewarm
+    {
+    public:
+        RxPrewarm(
+            bool useLargePages_, const Bigint& K_,
+            const std::vector<u32>& initCores_, RxMode mode_);
+
+        // Cancels and waits for the thread
+        ~RxPrewarm();
+
+        // Returns at once; the thread stops at the next chunk boundary
+        void cancel();
+        bool isCancelled() const;
+        bool isFinished() const;
+
+        // Only meaningful once finished; empty if there was no error
+        std::string getError() const;
+
+        const Bigint K;
+
+    private:
+        static void threadEntry(RxPrewarm* prewarm);
+
+        const bool useLargePages;
+        const std::vector<u32> initCores;
+        const RxMode mode;
+
+        std::atomic<bool> cancelled;
+        std::atomic<bool> finished;
+        std::string error;
+
+        // Last, so everything above exists before it starts
+        std::thread thread;
+    };
+
+    /* Measures how RX scales with cores: dataset init rate as init cores
+       are added, and full-mode hash rate as hash cores are added, with and
+       without large pages. For sizing hardware and for catching regressions
+       after RandomX or compiler upgrades. Runs on its own thread, using a
+       dataset of its own (about 2 GiB). */
+    class RxScalingBenchmark
+    {
+    public:
+        struct Options
+        {
+            // Cores in the order they're added; empty means every core
+            std::vector<u32> cores;
+
+            // Steps, in cores used; empty means 1, 2, 4... and all of them
+            std::vector<u32> coreCounts;
+
+            bool withoutLargePages = true;
+            bool withLargePages = true;
+
+            // Dataset init chunks timed per core at each step
+            u32 initChunksPerCore = 32;
+
+            // Time spent hashing at each step
+            double hashSeconds = 2;
+        };
+
+        struct Point
+        {
+            u32 cores = 0;
+
+            // Dataset items or hashes per second
+            double rate = 0;
+            double perCore = 0;
+
+            // `perCore` relative to that of the first step
+            double efficiency = 0;
+        };
+
+        struct Curve
+        {
+            bool largePages = false;
+
+            // Seconds to build the whole dataset with every core
+            double datasetBuild = 0;
+
+            std::vector<Point> init;
+            std::vector<Point> hash;
+        };
+
+        struct Report
+        {
+            std::vector<Curve> curves;
+            std::vector<std::string> warnings;
+        };
+
+        explicit RxScalingBenchmark(const Options& options_);
+
+        // Cancels, then waits for the thread
+        ~RxScalingBenchmark();
+
+        void cancel();
+        bool isFinished() const;
+
+        // The step being measured, for display
+        std::string getStatus() const;
+
+        // Only meaningful once finished; partial if cancelled
+        Report getReport() const;
+
+        /* One table per curve, with the dataset init time each init step's
+           rate works out to. */
+        static std::string formatText(const Report& report);
+        static std::string formatJson(const Report& report);
+
+        static std::vector<u32> defaultCoreCounts(u32 coreCount);
+
+    private:
+        static void threadEntry(RxScalingBenchmark* benchmark);
+        void runCurve(bool largePages);
+        void setStatus(const std::string& status_);
+
+        const Options options;
+        std::atomic<bool> cancelled;
+        std::atomic<bool> finished;
+
+        mutable std::mutex mutex;
+        std::string status;
+        Report report;
+
+        // Last, so everything above exists before it starts
+        std::thread thread;
+    };
+
+    /* Finds the v0 proofs in a large document, such as a scraped page or a
+       thread export, without copying it. Magic sequences are found in one
+       pass; a `Delimiter` then works out the record (post) around each. */
+    class ProofExtractorV0
+    {
+    public:
+        /* Returns the [begin, end) of the record holding the magic sequence
+           at `magicPos`. The record mustn't begin before `from`, which is
+           where the previous one ended. */
+        using Delimiter = std::function<std::pair<size_t, size_t>(
+            std::string_view doc, size_t from, size_t magicPos)>;
+
+        // Records separated by `separator`, e.g. "\x1e" or "</article>"
+        static Delimiter separatedBy(std::string separator);
+
+        explicit ProofExtractorV0(Delimiter delimiter_);
+
+        /* Every record holding a magic sequence, in document order, as
+           views into `doc`. A record holding several is returned once. */
+        std::vector<std::string_view> extract(std::string_view doc) const;
+
+        // Offsets of every magic sequence in `doc`, in order
+        static std::vector<size_t> findMagic(std::string_view doc);
+
+    private:
+        const Delimiter delimiter;
+    };
+
+    /* Verifies many v0 proofs in one go. Proofs are grouped by K so that
+       each RX cache is initialized once, however many proofs share it, and
+       a group's hashes are spread over a pool of VMs on that cache. */
+    class BatchVerifierV0
+    {
+    public:
+        // Same meaning as the `verifyMessage` outputs
+        struct Result
+        {
+            // Proof parsed as v0; false means the other fields are empty
+            bool parsed = false;
+
+            /* Without `body`, which is the proof up to its first '|' and is
+               only copied, into `res->proof`, once hashed. */
+            PowerV0::ProofContent content;
+            std::optional<HashResult> res;
+            std::string prettyMetaData;
+            std::string error;
+        };
+
+        /* What the light/full choice is based on, measured on this machine.
+           Hash times are for one thread; `fullHash` is derived from the
+           others until a full-mode group has been timed. */
+        struct Calibration
+        {
+            double lightHash = 0;
+            double fullHash = 0;
+            bool fullHashMeasured = false;
+
+            // With one init thread per hardware thread
+            double datasetBuild = 0;
+        };
+
+        /* `threadCount` of 0 means one per hardware thread. `maxCaches` of 0
+           means as many as fit in half of the available memory (at least
+           one, at most `threadCount`). With `adaptive`, a K shared by enough
+           proofs to pay for its dataset is verified in full mode. */
+        BatchVerifierV0(
+            bool useLargePages_, u32 threadCount_ = 0, u32 maxCaches_ = 0,
+            bool adaptive_ = true);
+
+        // Results are in the order of `proofs`
+        std::vector<Result> verify(const std::vector<std::string>& proofs);
+
+        /* As above, counting finished proofs in `done`. Once `cancelled` is
+           set, proofs not yet hashed get an error instead. Cancellation is
+           noticed between hashes, after an RX cache init (which can't be cut
+           short) and within a dataset build. */
+        std::vector<Result> verify(
+            const std::vector<std::string>& proofs,
+            const std::atomic<bool>& cancelled, std::atomic<size_t>& done);
+
+        /* As above, for views such as those from `ProofExtractorV0`. What
+           they point to must outlive the call. */
+        std::vector<Result> verify(const std::vector<std::string_view>& proofs);
+        std::vector<Result> verify(
+            const std::vector<std::string_view>& proofs,
+            const std::atomic<bool>& cancelled, std::atomic<size_t>& done);
+
+        // Distinct Ks seen by the last `verify`, i.e. caches initialized
+        size_t getLastGroupCount() const;
+
+        /* One JSON object (no newline) with a "status" of "ok" (and "diff",
+           "hash", "userId" and "context"), "error" (and "error"), or
+           "invalid" for input which isn't a v0 proof. */
+        static std::string formatResult(const Result& result);
+
+        // Groups of the last `verify` which were hashed with a dataset
+        size_t getLastFullGroupCount() const;
+
+        /* Measured on first use (which takes a second or so) and refined by
+           every full-mode group verified since, separately with and without
+           large pages. */
+        static Calibration getCalibration(bool useLargePages);
+
+        /* Group size above which building the dataset is faster than light
+           mode hashing, for `hashThreads` threads sharing the group. */
+        static size_t getBreakEven(const Calibration& calibration, u32 hashThreads);
+
+    private:
+        static Calibration calibrate(bool useLargePages);
+        static void refineCalibration(
+            bool useLargePages, double fullHash, std::optional<double> datasetBuild);
+
+        const bool useLargePages;
+        const u32 threadCount;
+        const u32 maxCaches;
+        const bool adaptive;
+
+        size_t lastGroupCount = 0;
+        size_t lastFullGroupCount = 0;
+    };
+
+    /* Runs batches of v0 proofs through `BatchVerifierV0` on worker threads,
+       so that callers don't block on RX initialization. A single proof is
+       a batch of one. */
+    class AsyncVerifierV0
+    {
+    public:
+        using Results = std::vector<BatchVerifierV0::Result>;
+
+        /* Runs on the worker thread once the job's future is ready. Anything
+           it throws is dropped. */
+        using Callback = std::function<void(const Results&)>;
+
+        class Job
+        {
+        public:
+            // Works whether the job is queued or running; see `BatchVerifierV0`
+            void cancel();
+            bool isCancelled() const;
+
+            // False while queued
+            bool isStarted() const;
+
+            // Proofs finished so far, out of `getTotal()`
+            size_t getDone() const;
+            size_t getTotal() const;
+
+            // Always becomes ready, with cancelled proofs marked as such
+            std::shared_future<Results> getFuture() const;
+
+        private:
+            friend class AsyncVerifierV0;
+
+            Job(std::vector<std::string>&& proofs_, bool useLargePages_, Callback&& callback_);
+
+            const std::vector<std::string> proofs;
+            const bool useLargePages;
+            const Callback callback;
+
+            std::atomic<bool> cancelled{false};
+            std::atomic<bool> started{false};
+            std::atomic<size_t> done{0};
+
+            std::promise<Results> promise;
+            const std::shared_future<Results> future;
+        };
+
+        /* Up to `workerCount` jobs run at once, each with `threadsPerJob`
+           hashing threads (0 meaning one per hardware thread). */
+        AsyncVerifierV0(u32 workerCount = 1, u32 threadsPerJob_ = 0);
+
+        // Cancels every job, then waits for the workers to finish them
+        ~AsyncVerifierV0();
+
+        /* Once the verifier is being destroyed (e.g. from a callback), the
+           job is finished at once as cancelled, on the calling thread. */
+        std::shared_ptr<Job> submit(
+            std::vector<std::string> proofs, bool useLargePages,
+            Callback callback = nullptr);
+
+        // Jobs waiting for a worker
+        size_t getQueued() const;
+
+    private:
+        void workerEntry();
+
+        // Verifies `job`, then makes its future ready and calls back
+        void runJob(Job& job) const;
+
+        const u32 threadsPerJob;
+
+        mutable std::mutex mutex;
+        std::condition_variable queueChanged;
+        std::deque<std::shared_ptr<Job>> queue;
+        std::vector<std::shared_ptr<Job>> running;
+        bool stopping = false;
+
+        // Last, so everything above exists before they start
+        std::vector<std::thread> workers;
+    };
+
+#ifndef _WIN32
+    /* Serves v0 verification on a Unix domain socket, so that processes on
+       one host share a warm `RxCachePool`. Each line received is a proof;
+       each gets one line back, in order, from `BatchVerifierV0::formatResult`
+       or with a "status" of "busy" when the queue was full and the proof
+       was shed unverified.
+
+       One thread does all socket I/O; `workerCount` workers each take up to
+       `maxBatch` queued proofs at a time, so proofs sharing a K share a
+       cache however many clients they come from. */
+    class VerifyDaemon
+    {
+    public:
+        struct Options
+        {
+            std::string socketPath;
+            bool useLargePages = false;
+
+            u32 workerCount = 1;
+
+            // Hashing threads per worker; 0 means one per hardware thread
+            u32 threadsPerWorker = 0;
+
+            // Proofs waiting for a worker, over all clients
+            size_t maxQueued = 4096;
+            size_t maxBatch = 256;
+
+            size_t maxConnections = 64;
+
+            // A longer line gets an "invalid" reply and the client is dropped
+            size_t maxLineBytes = 1 << 20;
+
+            /* A client with this many replies owed, or this many bytes of
+               them unsent, isn't read from until it catches up */
+            size_t maxPendingReplies = 1024;
+            size_t maxUnsentBytes = 1 << 20;
+        };
+
+        struct Stats
+        {
+            u64 connections = 0;
+            u64 requests = 0;
+            u64 verified = 0;
+            u64 shed = 0;
+        };
+
+        explicit VerifyDaemon(const Options& options_);
+
+        // Stops, if running
+        ~VerifyDaemon();
+
+        /* Binds the socket (replacing a stale socket file, but not one a
+           live server answers on) and starts the threads. */
+        bool start(std::string& error);
+
+        // Drops clients, abandons queued proofs and removes the socket file
+        void stop();
+
+        Stats getStats() const;
+
+    private:
+        struct Request;
+        struct Connection;
+
+        void ioEntry();
+        void workerEntry();
+        void wake();
+
+        // Too many replies owed to read more from the client
+        bool isBackedUp(const Connection& conn) const;
+
+        // Handles the complete lines in `conn.in`, as far as backpressure allows
+        void takeLines(Connection& conn);
+
+        // Called by the I/O thread for each complete line
+        void handleLine(Connection& conn, const std::string& line);
+
+        const Options options;
+
+        int listenFd = -1;
+        int wakeFds[2] = { -1, -1 };
+        std::atomic<bool> stopping{false};
+
+        mutable std::mutex mutex;
+        std::condition_variable queueChanged;
+        std::deque<std::shared_ptr<Request>> queue;
+        Stats stats;
+
+        std::thread ioThread;
+        std::vector<std::thread> workers;
+    };
+#endif
 }
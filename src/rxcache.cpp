@@ -0,0 +1,999 @@
+#include <cstddef>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include "power.hpp"
+
+#include "configuration.h"
+
+namespace
+{
+    using namespace wxpower;
+
+    /* Snapshot file layout: a header padded to one page, then the raw
+       dataset memory. The header pins down everything the dataset contents
+       depend on, so a snapshot from a differently configured build (or for
+       another K) is never used. Native byte order; snapshots are a local
+       cache and not meant to be moved between machines. */
+    const char snapshotMagic[16] = "wxPoWer RXDS v0";
+    const u64 snapshotHeaderBytes = 4096;
+
+    // Unit of work for loading and checksumming
+    const u64 snapshotChunkBytes = static_cast<u64>(64) << 20;
+
+    static_assert(sizeof(RANDOMX_ARGON_SALT) <= 16, "RX salt too long for snapshot header");
+
+    struct SnapshotHeader
+    {
+        char magic[16];
+        u64 config[10];
+        char salt[16];
+        u8 K[32];
+
+        // Not part of the comparison with the expected header
+        u64 checksum;
+    };
+
+    static_assert(sizeof(SnapshotHeader) <= snapshotHeaderBytes, "Snapshot header too large");
+
+    u64 snapshotDataBytes()
+    {
+        return static_cast<u64>(randomx_dataset_item_count()) * RANDOMX_DATASET_ITEM_SIZE;
+    }
+
+    SnapshotHeader expectedHeader(const Bigint& K, u64 dataBytes)
+    {
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+
+        memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+
+        const u64 config[] = {
+            dataBytes, snapshotChunkBytes,
+            RANDOMX_ARGON_MEMORY, RANDOMX_ARGON_ITERATIONS, RANDOMX_ARGON_LANES,
+            RANDOMX_CACHE_ACCESSES, RANDOMX_SUPERSCALAR_LATENCY,
+            RANDOMX_DATASET_BASE_SIZE, RANDOMX_DATASET_EXTRA_SIZE,
+            RANDOMX_PROGRAM_SIZE };
+
+        static_assert(sizeof(config) == sizeof(header.config), "Snapshot config size mismatch");
+
+        memcpy(header.config, config, sizeof(config));
+        memcpy(header.salt, RANDOMX_ARGON_SALT, sizeof(RANDOMX_ARGON_SALT));
+        memcpy(header.K, K.getBytes(), 32);
+
+        return header;
+    }
+
+    u64 rotl64(u64 x, u32 r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    /* Checksums one chunk, optionally copying it to `dst` on the way, so a
+       load reads the snapshot only once. Four independent lanes keep the
+       multiply chain off the critical path of the copy. Chunks are mixed
+       with their index and summed, so they can be processed in any order.
+       This guards against truncated or damaged files, not against tampering;
+       anyone who can write the cache directory can do worse anyway. */
+    u64 checksumChunk(const u64* src, u64* dst, u64 words, u64 index)
+    {
+        assert((words % 4) == 0);
+
+        const u64 prime = 0x100000001b3ULL;
+        u64 lanes[4] = {
+            index * 4 + 0x9e3779b97f4a7c15ULL, index * 4 + 1,
+            index * 4 + 2, index * 4 + 3 };
+
+        for (u64 i = 0; i < words; i += 4)
+            for (u32 j = 0; j < 4; j++)
+            {
+                const u64 w = src[i + j];
+
+                if (dst != nullptr)
+                    dst[i + j] = w;
+
+                lanes[j] = rotl64((lanes[j] ^ w) * prime, 31);
+            }
+
+        // splitmix64 finalizer
+        u64 h = lanes[0] ^ rotl64(lanes[1], 16) ^ rotl64(lanes[2], 32) ^ rotl64(lanes[3], 48);
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+
+        return h ^ (h >> 31);
+    }
+
+    // Read-only view of a whole file; `data()` is nullptr if mapping failed
+    class MappedFile
+    {
+    public:
+        MappedFile(const std::string& path)
+        {
+#ifdef _WIN32
+            file = CreateFileW(std::filesystem::u8path(path).c_str(), GENERIC_READ,
+                FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+            LARGE_INTEGER fileSize;
+
+            if ((file == INVALID_HANDLE_VALUE) || !GetFileSizeEx(file, &fileSize) ||
+                (fileSize.QuadPart <= 0))
+                return;
+
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+            if (mapping == nullptr)
+                return;
+
+            ptr = static_cast<const u8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+            if (ptr != nullptr)
+                bytes = static_cast<u64>(fileSize.QuadPart);
+#else
+            fd = open(path.c_str(), O_RDONLY);
+
+            struct stat st;
+
+            if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size <= 0))
+                return;
+
+            void* const mapped = mmap(nullptr, static_cast<size_t>(st.st_size),
+                PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (mapped == MAP_FAILED)
+                return;
+
+            // Start reading ahead; the copy touches every page exactly once
+            madvise(mapped, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+
+            ptr = static_cast<const u8*>(mapped);
+            bytes = static_cast<u64>(st.st_size);
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifdef _WIN32
+            if (ptr != nullptr)
+                UnmapViewOfFile(ptr);
+
+            if (mapping != nullptr)
+                CloseHandle(mapping);
+
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+#else
+            if (ptr != nullptr)
+                munmap(const_cast<u8*>(ptr), static_cast<size_t>(bytes));
+
+            if (fd >= 0)
+                close(fd);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const u8* data() const { return ptr; }
+        u64 size() const { return bytes; }
+
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int fd = -1;
+#endif
+        const u8* ptr = nullptr;
+        u64 bytes = 0;
+    };
+}
+
+namespace wxpower
+{
+    std::shared_ptr<RxDataset> RxDataset::alloc(const Bigint& K, randomx_flags flags)
+    {
+        std::shared_ptr<RxDataset> ret;
+        randomx_dataset* const dataset = randomx_alloc_dataset(flags);
+
+        if (dataset != nullptr)
+            ret.reset(new RxDataset(K, dataset));
+
+        return ret;
+    }
+
+    RxDataset::RxDataset(const Bigint& K_, randomx_dataset* dataset_) :
+        K(K_), dataset(dataset_), doneChunks(getChunkCount(), 0)
+    {}
+
+    RxDataset::~RxDataset()
+    {
+        randomx_release_dataset(dataset);
+    }
+
+    randomx_dataset* RxDataset::get() const
+    {
+        return dataset;
+    }
+
+    u64 RxDataset::getBytes()
+    {
+        return static_cast<u64>(RANDOMX_DATASET_BASE_SIZE) + RANDOMX_DATASET_EXTRA_SIZE;
+    }
+
+    u64 RxDataset::getChunkCount()
+    {
+        return (randomx_dataset_item_count() + initChunkItems - 1) / initChunkItems;
+    }
+
+    bool RxDataset::isChunkDone(u64 chunk) const
+    {
+        return doneChunks.at(chunk) != 0;
+    }
+
+    void RxDataset::markChunkDone(u64 chunk)
+    {
+        doneChunks.at(chunk) = 1;
+    }
+
+    void RxDataset::markAllDone()
+    {
+        std::fill(doneChunks.begin(), doneChunks.end(), 1);
+    }
+
+    bool RxDataset::isComplete() const
+    {
+        return std::find(doneChunks.cbegin(), doneChunks.cend(), 0) == doneChunks.cend();
+    }
+
+    u64 RxDataset::getDoneItems() const
+    {
+        const u64 itemCount = randomx_dataset_item_count();
+        u64 ret = 0;
+
+        for (u64 chunk = 0; chunk < doneChunks.size(); chunk++)
+            if (doneChunks[chunk] != 0)
+                ret += std::min<u64>(initChunkItems, itemCount - chunk * initChunkItems);
+
+        return ret;
+    }
+
+    RxDatasetCache& RxDatasetCache::instance()
+    {
+        static RxDatasetCache cache;
+        return cache;
+    }
+
+    RxDatasetCache::RxDatasetCache() :
+        budget(defaultBudget())
+    {}
+
+    std::shared_ptr<RxDataset> RxDatasetCache::acquire(const Bigint& K)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<RxDataset> ret;
+
+        for (size_t i = 0; i < entries.size(); i++)
+            if (memcmp(entries[i]->K.getBytes(), K.getBytes(), 32) == 0)
+            {
+                ret = entries[i];
+                entries.erase(entries.begin() + i);
+
+                // Move to the most recently used end, unless it's being finished
+                if (ret->isComplete())
+                    entries.push_back(ret);
+
+                break;
+            }
+
+        return ret;
+    }
+
+    bool RxDatasetCache::contains(const Bigint& K) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const std::shared_ptr<RxDataset>& entry : entries)
+            if ((memcmp(entry->K.getBytes(), K.getBytes(), 32) == 0) && entry->isComplete())
+                return true;
+
+        return false;
+    }
+
+    void RxDatasetCache::insert(const std::shared_ptr<RxDataset>& dataset)
+    {
+        assert(dataset);
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (RxDataset::getBytes() > budget)
+            return;
+
+        for (const std::shared_ptr<RxDataset>& entry : entries)
+            if (memcmp(entry->K.getBytes(), dataset->K.getBytes(), 32) == 0)
+                return;
+
+        makeRoomLocked(RxDataset::getBytes());
+        entries.push_back(dataset);
+    }
+
+    void RxDatasetCache::makeRoom(u64 bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        makeRoomLocked(bytes);
+    }
+
+    void RxDatasetCache::trim()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        makeRoomLocked(0);
+    }
+
+    void RxDatasetCache::makeRoomLocked(u64 bytes)
+    {
+        u64 used = entries.size() * RxDataset::getBytes();
+
+        for (size_t i = 0; (i < entries.size()) && ((used + bytes) > budget);)
+        {
+            // Only the cache holds a reference, so it's safe to free
+            if (entries[i].use_count() == 1)
+            {
+                entries.erase(entries.begin() + i);
+                used -= RxDataset::getBytes();
+            }
+            else
+                i++;
+        }
+    }
+
+    void RxDatasetCache::setBudget(u64 bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        budget = bytes;
+        makeRoomLocked(0);
+    }
+
+    u64 RxDatasetCache::getBudget() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return budget;
+    }
+
+    u64 RxDatasetCache::getUsedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size() * RxDataset::getBytes();
+    }
+
+    u64 RxDatasetCache::defaultBudget()
+    {
+        return RxDataset::getBytes();
+    }
+
+    RxDatasetCache::~RxDatasetCache()
+    {
+        /* Lets a write in progress finish, otherwise short-lived processes
+           would never leave a snapshot behind. */
+        if (snapshotWriter.joinable())
+            snapshotWriter.join();
+    }
+
+    void RxDatasetCache::setSnapshotDir(const std::string& dir, u64 maxBytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        snapshotDir = dir;
+        snapshotMaxBytes = maxBytes;
+    }
+
+    std::string RxDatasetCache::snapshotFileName(const Bigint& K)
+    {
+        return K.toString() + ".rxds";
+    }
+
+    u64 RxDatasetCache::getSnapshotBytes()
+    {
+        return snapshotHeaderBytes + snapshotDataBytes();
+    }
+
+    std::vector<std::string> RxDatasetCache::takeSnapshotWarnings()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> ret;
+
+        ret.swap(snapshotWarnings);
+        return ret;
+    }
+
+    bool RxDatasetCache::loadSnapshot(
+        RxDataset& dataset, const std::vector<u32>& cores,
+        const std::atomic<bool>& cancelled, std::vector<std::string>& warnings)
+    {
+        std::string dir;
+
+        // Mutex scope
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            dir = snapshotDir;
+        }
+
+        if (dir.empty())
+            return false;
+
+        const std::filesystem::path path =
+            std::filesystem::u8path(dir) / snapshotFileName(dataset.K);
+        std::error_code ec;
+
+        if (!std::filesystem::exists(path, ec))
+            return false;
+
+        std::string problem;
+
+        if (!readSnapshotFile(path.u8string(), dataset.K,
+            randomx_get_dataset_memory(dataset.get()), snapshotDataBytes(),
+            cores, cancelled, problem))
+        {
+            // Cancelled
+            if (problem.empty())
+                return false;
+
+            warnings.push_back("RX dataset snapshot '" + path.u8string() + "' " +
+                problem + "; rebuilding it.");
+
+            std::filesystem::remove(path, ec);
+            return false;
+        }
+
+        dataset.markAllDone();
+
+        // Eviction goes by modification time, so mark it as recently used
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+        return true;
+    }
+
+    void RxDatasetCache::saveSnapshot(const std::shared_ptr<RxDataset>& dataset)
+    {
+        assert(dataset);
+        std::string dir;
+        u64 maxBytes;
+
+        // Mutex scope
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            dir = snapshotDir;
+            maxBytes = snapshotMaxBytes;
+        }
+
+        if (dir.empty() || (getSnapshotBytes() > maxBytes) || !dataset->isComplete())
+            return;
+
+        std::lock_guard<std::mutex> lock(writerMutex);
+
+        // One write at a time; they are disk bound anyway
+        if (snapshotWriter.joinable())
+            snapshotWriter.join();
+
+        snapshotWriter = std::thread(
+            &RxDatasetCache::writeSnapshot, this, dataset, dir, maxBytes);
+    }
+
+    void RxDatasetCache::writeSnapshot(
+        std::shared_ptr<RxDataset> dataset, std::string dir, u64 maxBytes)
+    {
+        namespace fs = std::filesystem;
+
+        const fs::path dirPath = fs::u8path(dir);
+        const fs::path path = dirPath / snapshotFileName(dataset->K);
+        std::error_code ec;
+
+        auto warn = [&](const std::string& what)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            snapshotWarnings.push_back(what);
+        };
+
+        if (fs::exists(path, ec))
+            return;
+
+        fs::create_directories(dirPath, ec);
+
+        if (!evictSnapshots(dir, getSnapshotBytes(), maxBytes))
+            return;
+
+        const fs::space_info space = fs::space(dirPath, ec);
+
+        if (!ec && (space.available < getSnapshotBytes()))
+        {
+            warn("Not enough disk space for an RX dataset snapshot in '" + dir + "'.");
+            return;
+        }
+
+        std::string error;
+
+        if (!writeSnapshotFile(path.u8string(), dataset->K,
+            randomx_get_dataset_memory(dataset->get()), snapshotDataBytes(), error))
+            warn(error);
+    }
+
+    bool RxDatasetCache::readSnapshotFile(
+        const std::string& path, const Bigint& K, void* dst, u64 dataBytes,
+        const std::vector<u32>& cores, const std::atomic<bool>& cancelled,
+        std::string& problem)
+    {
+        assert((dataBytes % 32) == 0);
+
+        const SnapshotHeader expected = expectedHeader(K, dataBytes);
+        const MappedFile file(path);
+
+        problem.clear();
+
+        if (file.data() == nullptr)
+            problem = "could not be mapped";
+        else if (file.size() != snapshotHeaderBytes + dataBytes)
+            problem = "has the wrong size";
+        else if (memcmp(file.data(), &expected, offsetof(SnapshotHeader, checksum)) != 0)
+            problem = "is for a different RX configuration";
+
+        if (!problem.empty())
+            return false;
+
+        u64 expectedChecksum = 0;
+        memcpy(&expectedChecksum, file.data() + offsetof(SnapshotHeader, checksum), sizeof(u64));
+
+        const u64* const src = reinterpret_cast<const u64*>(file.data() + snapshotHeaderBytes);
+        const u64 chunkCount = (dataBytes + snapshotChunkBytes - 1) / snapshotChunkBytes;
+        std::atomic<u64> nextChunk{0};
+        std::vector<u64> sums(cores.size(), 0);
+
+        // Threads take chunks until none are left
+        auto copyEntry = [&](size_t t)
+        {
+            for (u64 c = nextChunk.fetch_add(1); c < chunkCount; c = nextChunk.fetch_add(1))
+            {
+                if (cancelled.load())
+                    return;
+
+                const u64 begin = c * snapshotChunkBytes;
+                const u64 end = std::min(begin + snapshotChunkBytes, dataBytes);
+
+                sums[t] += checksumChunk(
+                    src + begin / 8, static_cast<u64*>(dst) + begin / 8, (end - begin) / 8, c);
+            }
+        };
+
+        std::vector<std::thread> threads;
+
+        for (size_t t = 0; t < cores.size(); t++)
+        {
+            threads.emplace_back(copyEntry, t);
+
+            // First touch from the init cores, as when building
+            setThreadAffinity(threads.back(), cores.at(t));
+        }
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        if (cancelled.load())
+            return false;
+
+        u64 checksum = 0;
+
+        for (u64 sum : sums)
+            checksum += sum;
+
+        if (checksum != expectedChecksum)
+        {
+            problem = "is corrupt";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool RxDatasetCache::writeSnapshotFile(
+        const std::string& path, const Bigint& K, const void* src, u64 dataBytes,
+        std::string& error)
+    {
+        namespace fs = std::filesystem;
+
+        assert((dataBytes % 32) == 0);
+
+        const fs::path finalPath = fs::u8path(path);
+        const fs::path tempPath = finalPath.u8string() + ".tmp";
+        const u64* const words = static_cast<const u64*>(src);
+        SnapshotHeader header = expectedHeader(K, dataBytes);
+        std::error_code ec;
+        bool ok = true;
+
+        // Scope
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+
+            // Header is written again once the checksum is known
+            std::vector<char> headerBlock(snapshotHeaderBytes, 0);
+            out.write(headerBlock.data(), headerBlock.size());
+
+            for (u64 begin = 0, c = 0; out && (begin < dataBytes);
+                begin += snapshotChunkBytes, c++)
+            {
+                const u64 end = std::min(begin + snapshotChunkBytes, dataBytes);
+
+                header.checksum += checksumChunk(words + begin / 8, nullptr, (end - begin) / 8, c);
+                out.write(reinterpret_cast<const char*>(words + begin / 8),
+                    static_cast<std::streamsize>(end - begin));
+            }
+
+            memcpy(headerBlock.data(), &header, sizeof(header));
+            out.seekp(0);
+            out.write(headerBlock.data(), sizeof(header));
+
+            if (!out.flush())
+            {
+                error = "Failed to write RX dataset snapshot '" + tempPath.u8string() + "'.";
+                ok = false;
+            }
+        }
+
+        if (ok)
+        {
+            fs::rename(tempPath, finalPath, ec);
+
+            if (ec)
+            {
+                error = "Failed to replace RX dataset snapshot '" + finalPath.u8string() +
+                    "': " + ec.message();
+                ok = false;
+            }
+        }
+
+        if (!ok)
+            fs::remove(tempPath, ec);
+
+        return ok;
+    }
+
+    bool RxDatasetCache::evictSnapshots(const std::string& dir, u64 incomingBytes, u64 maxBytes)
+    {
+        namespace fs = std::filesystem;
+
+        std::vector<std::pair<fs::file_time_type, fs::path>> existing;
+        std::error_code ec;
+        u64 used = 0;
+
+        for (const fs::directory_entry& entry : fs::directory_iterator(fs::u8path(dir), ec))
+            if (entry.is_regular_file(ec) && (entry.path().extension() == ".rxds"))
+            {
+                existing.emplace_back(entry.last_write_time(ec), entry.path());
+                used += entry.file_size(ec);
+            }
+
+        std::sort(existing.begin(), existing.end());
+
+        for (size_t i = 0; (i < existing.size()) && ((used + incomingBytes) > maxBytes); i++)
+        {
+            const u64 bytes = fs::file_size(existing[i].second, ec);
+
+            if (fs::remove(existing[i].second, ec))
+                used -= std::min(used, bytes);
+        }
+
+        return (used + incomingBytes) <= maxBytes;
+    }
+
+    RxCache::RxCache(randomx_cache* cache_, randomx_flags allocFlags_) :
+        cache(cache_), allocFlags(allocFlags_)
+    {}
+
+    RxCache::~RxCache()
+    {
+        randomx_release_cache(cache);
+    }
+
+    randomx_cache* RxCache::get() const
+    {
+        return cache;
+    }
+
+    const Bigint& RxCache::getK() const
+    {
+        return K;
+    }
+
+    double RxCache::getInitTime() const
+    {
+        return initTime;
+    }
+
+    u64 RxCache::getBytes()
+    {
+        return static_cast<u64>(RANDOMX_ARGON_MEMORY) * 1024;
+    }
+
+    double RxCachePool::Stats::getHitRate() const
+    {
+        const u64 total = hits + misses;
+        return (total > 0) ? static_cast<double>(hits) / total : 0;
+    }
+
+    RxCachePool& RxCachePool::instance()
+    {
+        static RxCachePool pool;
+        return pool;
+    }
+
+    RxCachePool::RxCachePool() :
+        budget(defaultBudget())
+    {}
+
+    std::shared_ptr<RxCache> RxCachePool::acquire(
+        const Bigint& K, bool useLargePages, bool& hit)
+    {
+        randomx_flags allocFlags = randomx_get_flags();
+
+        if (useLargePages)
+            allocFlags |= RANDOMX_FLAG_LARGE_PAGES;
+
+        const auto allocate = [&]()
+        {
+            randomx_cache* const cache = randomx_alloc_cache(allocFlags);
+
+            if (cache == nullptr)
+            {
+                std::string what = "Failed to initialize RX cache.";
+
+                if (useLargePages)
+                    what += " Try disabling large pages.";
+
+                throw RxManager::Exception(what);
+            }
+
+            return std::shared_ptr<RxCache>(new RxCache(cache, allocFlags));
+        };
+
+        std::unique_lock<std::mutex> lock(mutex);
+        std::shared_ptr<RxCache> entry;
+
+        hit = false;
+
+        while (!entry)
+        {
+            if (capacityLocked() == 0)
+            {
+                stats.misses++;
+                lock.unlock();
+
+                std::shared_ptr<RxCache> own = allocate();
+                const auto tic = NOW;
+
+                own->K = K;
+                randomx_init_cache(own->get(), K.getBytes(), 32);
+                own->initTime = SECS(NOW - tic);
+                own->ready = true;
+
+                return own;
+            }
+
+            const auto found = std::find_if(entries.begin(), entries.end(),
+                [&K](const std::shared_ptr<RxCache>& e)
+                { return memcmp(e->K.getBytes(), K.getBytes(), 32) == 0; });
+
+            if (found != entries.end())
+            {
+                // Someone else is initializing it
+                if (!(*found)->ready)
+                {
+                    released.wait(lock);
+                    continue;
+                }
+
+                entry = *found;
+                entries.erase(found);
+                entries.push_back(entry);
+
+                stats.hits++;
+                stats.initSecondsSaved += entry->initTime;
+                hit = true;
+            }
+            else if (entries.size() < capacityLocked())
+            {
+                entry = allocate();
+                entry->K = K;
+                entries.push_back(entry);
+            }
+            else
+            {
+                // Least recently used cache nobody holds
+                const auto lru = std::find_if(entries.begin(), entries.end(),
+                    [](const std::shared_ptr<RxCache>& e) { return e.use_count() == 1; });
+
+                if (lru == entries.end())
+                {
+                    released.wait(lock);
+                    continue;
+                }
+
+                stats.evictions++;
+
+                // Memory of the wrong kind is given back; the loop allocates
+                if ((*lru)->allocFlags != allocFlags)
+                {
+                    entries.erase(lru);
+                    continue;
+                }
+
+                entry = *lru;
+                entries.erase(lru);
+                entries.push_back(entry);
+
+                entry->K = K;
+                entry->ready = false;
+                stats.recycled++;
+            }
+        }
+
+        if (!hit)
+        {
+            stats.misses++;
+            lock.unlock();
+
+            // Pinned by `entry`, so it stays put while unlocked
+            const auto tic = NOW;
+            randomx_init_cache(entry->get(), K.getBytes(), 32);
+            const double initTime = SECS(NOW - tic);
+
+            lock.lock();
+            entry->initTime = initTime;
+            entry->ready = true;
+            lock.unlock();
+
+            released.notify_all();
+        }
+
+        // The deleter holds the pin until the caller lets go
+        RxCache* const raw = entry.get();
+
+        return std::shared_ptr<RxCache>(raw, [this, entry](RxCache*) mutable
+        {
+            release(entry);
+        });
+    }
+
+    void RxCachePool::release(std::shared_ptr<RxCache>& entry)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            entry.reset();
+            trimLocked();
+        }
+
+        released.notify_all();
+    }
+
+    void RxCachePool::trimLocked()
+    {
+        // Over budget only after `setBudget` lowered it
+        for (size_t i = 0; (i < entries.size()) && (entries.size() > capacityLocked());)
+        {
+            if (entries[i].use_count() == 1)
+            {
+                entries.erase(entries.begin() + i);
+                stats.evictions++;
+            }
+            else
+                i++;
+        }
+    }
+
+    void RxCachePool::setBudget(u64 bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        budget = bytes;
+        trimLocked();
+    }
+
+    u64 RxCachePool::getBudget() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return budget;
+    }
+
+    u64 RxCachePool::getUsedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size() * RxCache::getBytes();
+    }
+
+    u32 RxCachePool::getCapacity() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return capacityLocked();
+    }
+
+    u32 RxCachePool::capacityLocked() const
+    {
+        return static_cast<u32>(std::min<u64>(budget / RxCache::getBytes(), UINT32_MAX));
+    }
+
+    u64 RxCachePool::defaultBudget()
+    {
+        return 2 * RxCache::getBytes();
+    }
+
+    RxCachePool::Stats RxCachePool::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    void RxCachePool::resetStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats = Stats();
+    }
+
+    RxPrewarm::RxPrewarm(
+        bool useLargePages_, const Bigint& K_,
+        const std::vector<u32>& initCores_, RxMode mode_) :
+        K(K_), useLargePages(useLargePages_), initCores(initCores_), mode(mode_),
+        cancelled(false), finished(false), thread(threadEntry, this)
+    {
+        assert((mode == RxMode::full) || (mode == RxMode::automatic));
+    }
+
+    RxPrewarm::~RxPrewarm()
+    {
+        cancel();
+        thread.join();
+    }
+
+    void RxPrewarm::cancel()
+    {
+        cancelled.store(true);
+    }
+
+    bool RxPrewarm::isCancelled() const
+    {
+        return cancelled.load();
+    }
+
+    bool RxPrewarm::isFinished() const
+    {
+        return finished.load();
+    }
+
+    std::string RxPrewarm::getError() const
+    {
+        assert(finished.load());
+        return error;
+    }
+
+    void RxPrewarm::threadEntry(RxPrewarm* prewarm)
+    {
+        try
+        {
+            // No hash cores, so no VMs; the dataset ends up in the cache
+            RxManager rx(prewarm->useLargePages, prewarm->K, prewarm->initCores,
+                std::vector<u32>(), prewarm->cancelled, prewarm->mode);
+        }
+        catch (RxManager::Exception& e)
+        {
+            prewarm->error = e.getWhat();
+        }
+
+        prewarm->finished.store(true);
+    }
+}
@@ -0,0 +1,385 @@
+#include <cinttypes>
+#include <cstdio>
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <sstream>
+
+#include "power.hpp"
+
+namespace
+{
+    using namespace wxpower;
+
+    RxScalingBenchmark::Options resolveOptions(RxScalingBenchmark::Options options)
+    {
+        if (options.cores.empty())
+            for (u32 i = 0; i < std::max<u32>(std::thread::hardware_concurrency(), 1); i++)
+                options.cores.push_back(i);
+
+        const u32 coreCount = static_cast<u32>(options.cores.size());
+
+        if (options.coreCounts.empty())
+            options.coreCounts = RxScalingBenchmark::defaultCoreCounts(coreCount);
+
+        options.coreCounts.erase(std::remove_if(
+            options.coreCounts.begin(), options.coreCounts.end(),
+            [coreCount](u32 count) { return (count == 0) || (count > coreCount); }),
+            options.coreCounts.end());
+
+        options.initChunksPerCore = std::max<u32>(options.initChunksPerCore, 1);
+
+        return options;
+    }
+
+    /* Runs `fn(t)` for t below `count`, each on a thread pinned to
+       `cores[t]`. Returns false if any thread couldn't be pinned. */
+    template <typename F>
+    bool runPinned(const std::vector<u32>& cores, u32 count, const F& fn)
+    {
+        std::vector<std::thread> threads;
+        bool pinned = true;
+
+        for (u32 t = 0; t < count; t++)
+        {
+            threads.emplace_back(fn, t);
+            pinned = setThreadAffinity(threads.back(), cores.at(t)) && pinned;
+        }
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        return pinned;
+    }
+
+    void addPoint(std::vector<RxScalingBenchmark::Point>& points, u32 cores, double rate)
+    {
+        RxScalingBenchmark::Point point;
+
+        point.cores = cores;
+        point.rate = rate;
+        point.perCore = rate / cores;
+        point.efficiency = points.empty() ? 1 : (point.perCore / points.front().perCore);
+
+        points.push_back(point);
+    }
+
+    std::string pagesName(bool largePages)
+    {
+        return largePages ? "large pages" : "normal pages";
+    }
+}
+
+namespace wxpower
+{
+    RxScalingBenchmark::RxScalingBenchmark(const Options& options_) :
+        options(resolveOptions(options_)), cancelled(false), finished(false),
+        thread(threadEntry, this)
+    {}
+
+    RxScalingBenchmark::~RxScalingBenchmark()
+    {
+        cancel();
+        thread.join();
+    }
+
+    void RxScalingBenchmark::cancel()
+    {
+        cancelled.store(true);
+    }
+
+    bool RxScalingBenchmark::isFinished() const
+    {
+        return finished.load();
+    }
+
+    std::string RxScalingBenchmark::getStatus() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return status;
+    }
+
+    RxScalingBenchmark::Report RxScalingBenchmark::getReport() const
+    {
+        assert(finished.load());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return report;
+    }
+
+    std::vector<u32> RxScalingBenchmark::defaultCoreCounts(u32 coreCount)
+    {
+        std::vector<u32> ret;
+
+        for (u32 count = 1; count < coreCount; count *= 2)
+            ret.push_back(count);
+
+        if (coreCount > 0)
+            ret.push_back(coreCount);
+
+        return ret;
+    }
+
+    void RxScalingBenchmark::setStatus(const std::string& status_)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        status = status_;
+    }
+
+    void RxScalingBenchmark::threadEntry(RxScalingBenchmark* benchmark)
+    {
+        if (benchmark->options.withoutLargePages && !benchmark->cancelled.load())
+            benchmark->runCurve(false);
+
+        if (benchmark->options.withLargePages && !benchmark->cancelled.load())
+            benchmark->runCurve(true);
+
+        benchmark->setStatus(benchmark->cancelled.load() ? "Cancelled" : "Finished");
+        benchmark->finished.store(true);
+    }
+
+    void RxScalingBenchmark::runCurve(bool largePages)
+    {
+        const std::string pages = pagesName(largePages);
+        const std::vector<u32>& cores = options.cores;
+        const unsigned long itemCount = randomx_dataset_item_count();
+        const unsigned long chunkItems = RxDataset::initChunkItems;
+        const auto warn = [this](const std::string& warning)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            report.warnings.push_back(warning);
+        };
+
+        randomx_flags flags = randomx_get_flags();
+
+        if (largePages)
+            flags |= RANDOMX_FLAG_LARGE_PAGES;
+
+        setStatus("Allocating RX memory (" + pages + ")");
+
+        // Any K will do
+        const Bigint K;
+        const std::unique_ptr<randomx_cache, void (*)(randomx_cache*)> cache(
+            randomx_alloc_cache(flags), randomx_release_cache);
+
+        RxDatasetCache::instance().makeRoom(RxDataset::getBytes());
+        const std::shared_ptr<RxDataset> dataset = RxDataset::alloc(K, flags);
+
+        if (!cache || !dataset)
+        {
+            warn("Failed to allocate RX memory with " + pages + "; skipped.");
+            return;
+        }
+
+        randomx_init_cache(cache.get(), K.getBytes(), 32);
+
+        Curve curve;
+        bool pinned = true;
+
+        curve.largePages = largePages;
+
+        /* The whole dataset first: hashing needs it, and the init steps
+           below then don't pay for first touching its pages. */
+        {
+            std::atomic<unsigned long> nextChunk{0};
+
+            setStatus("Building the dataset with " + std::to_string(cores.size()) +
+                " cores (" + pages + ")");
+
+            const auto tic = NOW;
+
+            pinned = runPinned(cores, static_cast<u32>(cores.size()), [&](u32)
+            {
+                for (unsigned long chunk = nextChunk.fetch_add(1);
+                    !cancelled.load() && ((chunk * chunkItems) < itemCount);
+                    chunk = nextChunk.fetch_add(1))
+                {
+                    randomx_init_dataset(dataset->get(), cache.get(), chunk * chunkItems,
+                        std::min(chunkItems, itemCount - chunk * chunkItems));
+                }
+            }) && pinned;
+
+            curve.datasetBuild = SECS(NOW - tic);
+        }
+
+        // Nothing measured yet worth reporting
+        if (cancelled.load())
+            return;
+
+        // Each core inits chunks of its own
+        for (const u32 count : options.coreCounts)
+        {
+            if (cancelled.load())
+                break;
+
+            setStatus("Dataset init with " + std::to_string(count) + " cores (" + pages + ")");
+
+            const unsigned long chunks = std::max<unsigned long>(std::min<unsigned long>(
+                options.initChunksPerCore, (RxDataset::getChunkCount() - 1) / count), 1);
+            const auto tic = NOW;
+
+            pinned = runPinned(cores, count, [&](u32 t)
+            {
+                randomx_init_dataset(dataset->get(), cache.get(),
+                    t * chunks * chunkItems, chunks * chunkItems);
+            }) && pinned;
+
+            addPoint(curve.init, count, count * chunks * chunkItems / SECS(NOW - tic));
+        }
+
+        for (const u32 count : options.coreCounts)
+        {
+            if (cancelled.load())
+                break;
+
+            setStatus("Hashing with " + std::to_string(count) + " cores (" + pages + ")");
+
+            std::vector<randomx_vm*> vms;
+
+            for (u32 t = 0; t < count; t++)
+            {
+                randomx_vm* const vm = randomx_create_vm(
+                    flags | RANDOMX_FLAG_FULL_MEM, nullptr, dataset->get());
+
+                if (vm == nullptr)
+                    break;
+
+                vms.push_back(vm);
+            }
+
+            if (vms.size() < count)
+            {
+                warn("Failed to create " + std::to_string(count) + " RX VMs with " + pages + ".");
+
+                for (randomx_vm* vm : vms)
+                    randomx_destroy_vm(vm);
+
+                break;
+            }
+
+            // Each thread times itself, so that staggered starts don't count
+            std::vector<double> rates(count, 0);
+
+            pinned = runPinned(cores, count, [&](u32 t)
+            {
+                u64 input = static_cast<u64>(t) << 40;
+                u64 hashes = 0;
+                Bigint hash;
+                const auto tic = NOW;
+
+                randomx_calculate_hash_first(vms.at(t), &input, sizeof(input));
+
+                do
+                {
+                    input++;
+                    randomx_calculate_hash_next(vms.at(t), &input, sizeof(input), hash.getBytes());
+                    hashes++;
+                }
+                while (!cancelled.load() && (SECS(NOW - tic) < options.hashSeconds));
+
+                randomx_calculate_hash_last(vms.at(t), hash.getBytes());
+                rates.at(t) = hashes / SECS(NOW - tic);
+            }) && pinned;
+
+            for (randomx_vm* vm : vms)
+                randomx_destroy_vm(vm);
+
+            // A step cut short by cancellation isn't representative
+            if (!cancelled.load())
+                addPoint(curve.hash, count, std::accumulate(rates.cbegin(), rates.cend(), 0.0));
+        }
+
+        if (!pinned)
+            warn("Failed to pin some threads to their cores with " + pages + ".");
+
+        std::lock_guard<std::mutex> lock(mutex);
+        report.curves.push_back(curve);
+    }
+
+    std::string RxScalingBenchmark::formatText(const Report& report)
+    {
+        const double itemCount = static_cast<double>(randomx_dataset_item_count());
+        std::stringstream ss;
+        char temp[128];
+
+        for (const Curve& curve : report.curves)
+        {
+            snprintf(temp, sizeof(temp), "%s; whole dataset built in %.2f s\n\n",
+                curve.largePages ? "Large pages" : "Normal pages", curve.datasetBuild);
+            ss << temp;
+
+            ss << "Init cores     Items/s    Per core  Efficiency  Dataset init\n";
+
+            for (const Point& point : curve.init)
+            {
+                snprintf(temp, sizeof(temp), "%10" PRIu32 "  %10.0f  %10.0f  %9.1f%%  %10.2f s\n",
+                    point.cores, point.rate, point.perCore, point.efficiency * 100,
+                    itemCount / point.rate);
+                ss << temp;
+            }
+
+            ss << "\nHash cores    Hashes/s    Per core  Efficiency\n";
+
+            for (const Point& point : curve.hash)
+            {
+                snprintf(temp, sizeof(temp), "%10" PRIu32 "  %10.1f  %10.1f  %9.1f%%\n",
+                    point.cores, point.rate, point.perCore, point.efficiency * 100);
+                ss << temp;
+            }
+
+            ss << "\n";
+        }
+
+        for (const std::string& warning : report.warnings)
+            ss << "Warning: " << warning << "\n";
+
+        return ss.str();
+    }
+
+    std::string RxScalingBenchmark::formatJson(const Report& report)
+    {
+        const auto points = [](std::stringstream& ss, const std::vector<Point>& list)
+        {
+            ss << "[";
+
+            for (size_t i = 0; i < list.size(); i++)
+            {
+                ss << ((i > 0) ? "," : "")
+                    << "{\"cores\":" << list[i].cores
+                    << ",\"rate\":" << list[i].rate
+                    << ",\"perCore\":" << list[i].perCore
+                    << ",\"efficiency\":" << list[i].efficiency << "}";
+            }
+
+            ss << "]";
+        };
+
+        std::stringstream ss;
+
+        ss << "{\"curves\":[";
+
+        for (size_t i = 0; i < report.curves.size(); i++)
+        {
+            const Curve& curve = report.curves[i];
+
+            ss << ((i > 0) ? "," : "")
+                << "{\"largePages\":" << (curve.largePages ? "true" : "false")
+                << ",\"datasetBuild\":" << curve.datasetBuild
+                << ",\"init\":";
+            points(ss, curve.init);
+            ss << ",\"hash\":";
+            points(ss, curve.hash);
+            ss << "}";
+        }
+
+        ss << "],\"warnings\":[";
+
+        for (size_t i = 0; i < report.warnings.size(); i++)
+            ss << ((i > 0) ? "," : "") << "\"" << jsonEscape(report.warnings[i]) << "\"";
+
+        ss << "]}";
+
+        return ss.str();
+    }
+}
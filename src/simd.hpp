@@ -0,0 +1,32 @@
+#pragma once
+
+/* Internal to the core library: what the SSE2 scanning loops in core.cpp
+   and extract.cpp share. Include after power.hpp. */
+
+#if defined(__SSE2__) || defined(_M_X64)
+# include <emmintrin.h>
+# define WXPOWER_SSE2
+#endif
+
+#ifdef _WIN32
+# include <intrin.h>
+#endif
+
+namespace wxpower
+{
+#ifdef WXPOWER_SSE2
+    // For movemask results; `val` must not be 0
+    inline u32 countTrailingZeros32(u32 val)
+    {
+        assert(val != 0);
+
+# ifdef _WIN32
+        unsigned long idx;
+        _BitScanForward(&idx, val);
+        return static_cast<u32>(idx);
+# else
+        return static_cast<u32>(__builtin_ctz(val));
+# endif
+    }
+#endif
+}
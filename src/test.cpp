@@ -1,8 +1,21 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <random>
+#include <stdexcept>
 #include <utility>
 
 #include <gtest-all.cc>
 #include <gtest_main.cc>
 
+#ifndef _WIN32
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <unistd.h>
+#endif
+
 #include "power.hpp"
 
 namespace wxpower
@@ -58,202 +71,1866 @@ namespace wxpower
         seed[0] = 0x20;
         EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(2));
 
-        seed[0] = 0x10;
-        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(3));
+        seed[0] = 0x10;
+        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(3));
+
+        seed[0] = 0x08;
+        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(4));
+
+        seed[0] = 0x04;
+        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(5));
+
+        seed[0] = 0x02;
+        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(6));
+
+        seed[0] = 0x01;
+        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(7));
+
+        seed[0] = 0;
+        seed[1] = 0x80;
+        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(8));
+    }
+
+    TEST(Test_Bigint_V0, Diff2)
+    {
+        Bigint obj;
+        u8* seed = obj.getBytes();
+
+        for (u32 i = 0; i < 32; i++)
+            for (u32 j = 0; j < 8; j++)
+            {
+                memset(seed, 0, 32);
+
+                seed[i] = UINT8_C(1) << (7 - j);
+
+                const u32 expectedDiff = i * 8 + j;
+                const u32 actualDiff = PowerV0::calcLZCDiff(obj);
+
+                EXPECT_EQ(actualDiff, expectedDiff);
+            }
+
+        {
+            memset(seed, 0, 32);
+
+            const u32 expectedDiff = 256;
+            const u32 actualDiff = PowerV0::calcLZCDiff(obj);
+
+            EXPECT_EQ(actualDiff, expectedDiff);
+        }
+    }
+
+    // Original bit-by-bit implementation, kept as the reference
+    static u32 refCalcLZCDiff(const Bigint& bigint)
+    {
+        const u8* buf = bigint.getBytes();
+
+        for (u32 i = 0; i < 32; i++)
+            for (u32 j = 0; j < 8; j++)
+            {
+                const u32 idx = i * 8 + j;
+                const unsigned char diffmask = 1 << (7 - j);
+
+                if (buf[i] & diffmask)
+                    return idx;
+            }
+
+        return 256;
+    }
+
+    /* Every leading bit position, with several random fills of the bits
+       below it, plus the all-zero hash. */
+    static std::vector<Bigint> makeLZCTestHashes()
+    {
+        std::mt19937 rng(12345);
+        std::vector<Bigint> ret;
+
+        for (u32 lead = 0; lead <= 256; lead++)
+            for (u32 rep = 0; rep < 8; rep++)
+            {
+                Bigint obj;
+                u8* seed = obj.getBytes();
+
+                memset(seed, 0, 32);
+
+                if (lead < 256)
+                {
+                    seed[lead / 8] = static_cast<u8>(0x80 >> (lead % 8));
+
+                    for (u32 bit = lead + 1; bit < 256; bit++)
+                        if (rng() & 1)
+                            seed[bit / 8] |= static_cast<u8>(0x80 >> (bit % 8));
+                }
+
+                ret.push_back(obj);
+            }
+
+        return ret;
+    }
+
+    TEST(Test_Bigint_V0, DiffMatchesReference)
+    {
+        for (const Bigint& obj : makeLZCTestHashes())
+            ASSERT_EQ(refCalcLZCDiff(obj), PowerV0::calcLZCDiff(obj))
+                << obj.toString();
+    }
+
+    TEST(Test_Bigint_V0, DiffAboveMatchesReference)
+    {
+        for (const Bigint& obj : makeLZCTestHashes())
+        {
+            const u32 expectedDiff = refCalcLZCDiff(obj);
+
+            for (u32 d = 0; d <= 257; d++)
+                ASSERT_EQ(expectedDiff > d, PowerV0::isLZCDiffAbove(obj, d))
+                    << obj.toString() << " vs " << d;
+        }
+    }
+
+    TEST(Test_Bigint_V0, DiffBatch)
+    {
+        const std::vector<Bigint> hashes = makeLZCTestHashes();
+        std::vector<u32> diffs(hashes.size(), UINT32_MAX);
+
+        PowerV0::calcLZCDiffs(hashes.data(), hashes.size(), diffs.data());
+
+        for (size_t i = 0; i < hashes.size(); i++)
+            ASSERT_EQ(refCalcLZCDiff(hashes.at(i)), diffs.at(i));
+    }
+
+    TEST(Test_Bigint_V0, FromString)
+    {
+        const std::string hex =
+            "c0535e4be2b79ffd93291305436bf889314e4a3faec05ecffcbb7df31ad9e51a";
+        Bigint obj;
+
+        ASSERT_TRUE(Bigint::fromString(hex, obj));
+        EXPECT_EQ(hex, obj.toString());
+
+        std::string upper = hex;
+
+        for (char& c : upper)
+            c = static_cast<char>(toupper(c));
+
+        ASSERT_TRUE(Bigint::fromString(upper, obj));
+        EXPECT_EQ(hex, obj.toString());
+
+        EXPECT_FALSE(Bigint::fromString(hex.substr(1), obj));
+        EXPECT_FALSE(Bigint::fromString(hex.substr(1) + "g", obj));
+        EXPECT_EQ(hex, obj.toString());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////
+
+    class TestB64Ctor32 : public ::testing::TestWithParam<
+        std::tuple<u32, std::string>>
+    {
+    public:
+        static const std::vector<std::tuple<u32, std::string>> tests;
+    };
+
+    const std::vector<std::tuple<u32, std::string>> TestB64Ctor32::tests =
+    {
+        {          0, "A" },
+        {          1, "B" },
+        {         12, "M" },
+        {      0x37e, "-N" },
+        {     0x3cb2, "yyD" },
+        {    0x572db, "bLXB" },
+        {   0x678ec9, "J74Z" },
+        {  0xe67d28b, "LK9ZO" },
+        { 0x57ce65ab, "rWmzXB" },
+        { 0x89abcdef, "v38qJC" },
+        { 0xffffffff, "_____D" }
+    };
+
+    TEST_P(TestB64Ctor32, TestProper)
+    {
+        const std::tuple<u32, std::string>& param = GetParam();
+        const u32 val = std::get<0>(param);
+        const std::string& expected = std::get<1>(param);
+
+        Base64 obj(val);
+
+        ASSERT_EQ(expected, obj.toString());
+    }
+
+    INSTANTIATE_TEST_SUITE_P(
+        ParamTest,
+        TestB64Ctor32,
+        ::testing::ValuesIn(TestB64Ctor32::tests));
+
+    class TestB64Ctor64 : public ::testing::TestWithParam<
+        std::tuple<u64, std::string>>
+    {
+    public:
+        static const std::vector<std::tuple<u64, std::string>> tests;
+    };
+
+    const std::vector<std::tuple<u64, std::string>> TestB64Ctor64::tests =
+    {
+        {                  0, "A" },
+        {                  1, "B" },
+        {                 12, "M" },
+        {              0x37e, "-N" },
+        {             0x3cb2, "yyD" },
+        {            0x572db, "bLXB" },
+        {           0x678ec9, "J74Z" },
+        {          0xe67d28b, "LK9ZO" },
+        {         0x57ce65ab, "rWmzXB" },
+        {         0x89abcdef, "v38qJC" },
+        {         0xffffffff, "_____D" },
+        {        0x8bc41fd99, "Z2fQ8i" },
+        {       0x8b4e3ea1cd, "NHqPOtI" },
+        {      0xfeb832d1a9c, "cqRLDu-D" },
+        {   0x1a2b3c4d5e6fee, "u_mXNxzKa" },
+        { 0xf9e8d7c6b5a43210, "QIDp1a81onP" }
+    };
+
+    TEST_P(TestB64Ctor64, TestProper)
+    {
+        const std::tuple<u64, std::string>& param = GetParam();
+        const u64 val = std::get<0>(param);
+        const std::string& expected = std::get<1>(param);
+
+        Base64 obj(val);
+
+        ASSERT_EQ(expected, obj.toString());
+    }
+
+    INSTANTIATE_TEST_SUITE_P(
+        ParamTest,
+        TestB64Ctor64,
+        ::testing::ValuesIn(TestB64Ctor64::tests));
+
+    TEST(TestB64, Incr)
+    {
+        Base64 obj;
+
+        EXPECT_EQ("A", obj.toString());
+
+        obj.incr();
+        EXPECT_EQ("B", obj.toString());
+
+        obj.incr();
+        EXPECT_EQ("C", obj.toString());
+
+        obj.incr();
+        EXPECT_EQ("D", obj.toString());
+
+        for (u32 i = 0; i < 60; i++)
+            obj.incr();
+
+        EXPECT_EQ("_", obj.toString());
+
+        obj.incr();
+        EXPECT_EQ("AB", obj.toString());
+
+        for (u32 i = 0; i < 63; i++)
+            obj.incr();
+
+        EXPECT_EQ("_B", obj.toString());
+
+        obj.incr();
+        EXPECT_EQ("AC", obj.toString());
+
+
+        for (u32 i = 0; i < (62 * 64 - 1); i++)
+            obj.incr();
+
+        EXPECT_EQ("__", obj.toString());
+
+        obj.incr();
+        EXPECT_EQ("AAB", obj.toString());
+    }
+
+    TEST(TestB64, IncrInPlace)
+    {
+        Base64 obj;
+        std::string printed = obj.toString();
+
+        for (u32 i = 0; i < (64 * 64 * 3); i++)
+        {
+            const u32 changed = obj.incr();
+
+            ASSERT_GE(obj.size(), printed.size());
+            printed.resize(obj.size());
+            obj.write(&printed[0], changed);
+
+            ASSERT_EQ(obj.toString(), printed);
+        }
+    }
+
+    TEST(TestNonceInput, MatchesConcat)
+    {
+        const std::string body = "Hello world!";
+        NonceInput input(body, Base64(1u));
+        Base64 ctr;
+
+        for (u32 i = 0; i < (64 * 64 + 5); i++)
+        {
+            const std::string expected = body + "|B|" + ctr.toString();
+
+            ASSERT_EQ(expected, std::string(input.data(), input.size()));
+            ASSERT_EQ(ctr.toString(), input.getCtr().toString());
+
+            input.incr();
+            ctr.incr();
+        }
+    }
+
+    TEST(TestNonceInput, Set)
+    {
+        NonceInput input("Hello world!");
+
+        EXPECT_EQ("Hello world!|A|A", std::string(input.data(), input.size()));
+
+        input.set(Base64(0x3cb2u), Base64(0x37eu));
+        EXPECT_EQ("Hello world!|yyD|-N", std::string(input.data(), input.size()));
+
+        input.incr();
+        EXPECT_EQ("Hello world!|yyD|_N", std::string(input.data(), input.size()));
+
+        input.set(Base64(), Base64(0xffffffffu));
+        EXPECT_EQ("Hello world!|A|_____D", std::string(input.data(), input.size()));
+        EXPECT_EQ("A", input.getSeed().toString());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////
+
+    TEST(TestNonceScheduler, Sequential)
+    {
+        NonceScheduler obj(16, 32);
+
+        for (u64 i = 0; i < 10; i++)
+        {
+            const NonceScheduler::Range range = obj.take();
+
+            EXPECT_EQ(32 + i * 16, range.begin);
+            EXPECT_EQ(32 + (i + 1) * 16, range.end);
+        }
+
+        EXPECT_EQ(UINT64_C(32 + 10 * 16), obj.getCursor());
+    }
+
+    TEST(TestNonceScheduler, GiveBack)
+    {
+        NonceScheduler obj(16);
+
+        obj.take();
+        obj.giveBack({ 5, 16 });
+        obj.giveBack({ 7, 7 });
+
+        ASSERT_EQ(UINT64_C(1), obj.getReturned().size());
+
+        NonceScheduler::Range range = obj.take();
+        EXPECT_EQ(UINT64_C(5), range.begin);
+        EXPECT_EQ(UINT64_C(16), range.end);
+
+        range = obj.take();
+        EXPECT_EQ(UINT64_C(16), range.begin);
+        EXPECT_TRUE(obj.getReturned().empty());
+    }
+
+    TEST(TestNonceScheduler, ThreadsCoverSpaceOnce)
+    {
+        const u64 blockSize = 7;
+        const u32 threadCount = 8;
+        const u32 takesPerThread = 2000;
+        NonceScheduler obj(blockSize);
+        std::vector<std::vector<u64>> seen(threadCount);
+        std::vector<std::thread> threads;
+
+        for (u32 t = 0; t < threadCount; t++)
+            threads.emplace_back([&, t]()
+            {
+                for (u32 i = 0; i < takesPerThread; i++)
+                {
+                    NonceScheduler::Range range = obj.take();
+
+                    // Half the time, stop part-way and hand the rest back
+                    if ((i & 1) && (t & 1))
+                    {
+                        seen[t].push_back(range.begin++);
+                        obj.giveBack(range);
+                    }
+                    else
+                    {
+                        for (; !range.empty(); range.begin++)
+                            seen[t].push_back(range.begin);
+                    }
+                }
+            });
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        std::vector<u64> all;
+
+        for (const std::vector<u64>& s : seen)
+            all.insert(all.end(), s.begin(), s.end());
+
+        for (const NonceScheduler::Range& range : obj.getReturned())
+            for (u64 n = range.begin; n < range.end; n++)
+                all.push_back(n);
+
+        std::sort(all.begin(), all.end());
+
+        ASSERT_EQ(obj.getCursor(), all.size());
+
+        for (u64 i = 0; i < all.size(); i++)
+            ASSERT_EQ(i, all.at(i));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////
+
+    TEST(TestNumaTopology, ParseCpuList)
+    {
+        const std::vector<std::pair<std::string, std::vector<u32>>> good = {
+            { "", {} },
+            { "\n", {} },
+            { "0", { 0 } },
+            { "0-3\n", { 0, 1, 2, 3 } },
+            { "0-1,8-9", { 0, 1, 8, 9 } },
+            { "2,4,6-7", { 2, 4, 6, 7 } }
+        };
+
+        for (const auto& [list, cores] : good)
+        {
+            const std::optional<std::vector<u32>> res = NumaTopology::parseCpuList(list);
+
+            ASSERT_TRUE(res.has_value()) << list;
+            EXPECT_EQ(cores, res.value()) << list;
+        }
+
+        for (const char* list : { "a", "1-", "-1", "3-1", "1,,2", "1 2", "+1", "4294967295-4294967295x" })
+            EXPECT_FALSE(NumaTopology::parseCpuList(list).has_value()) << list;
+    }
+
+    TEST(TestNumaTopology, NodeOf)
+    {
+        NumaTopology topology;
+        topology.nodeCores = { { 0, 1 }, {}, { 2, 3 } };
+
+        EXPECT_EQ(std::optional<u32>(0), topology.nodeOf(1));
+        EXPECT_EQ(std::optional<u32>(2), topology.nodeOf(3));
+        EXPECT_FALSE(topology.nodeOf(4).has_value());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////
+
+    TEST(TestProveV0Checkpoint, RoundTrip)
+    {
+        const std::string path =
+            (std::filesystem::temp_directory_path() / "wxpowertest.ckpt").string();
+
+        ProveV0Checkpoint saved;
+        saved.content = { " Multi-line\nbody|with|pipes \n", 0, "user\\|id", "" };
+        memset(saved.K.getBytes(), 0x5a, 32);
+        saved.blockSize = 1024;
+        saved.cursor = UINT64_C(0x123456789);
+        saved.pending = { { 5, 1024 }, { 2048 + 17, 3072 } };
+        saved.hashes = 987654321;
+        saved.best.proof = saved.content.body + "|B|C|wxPoW0|user\\|id|";
+        saved.best.diff = 17;
+        memset(saved.best.hash.getBytes(), 0, 32);
+        saved.best.hash.getBytes()[2] = 0x40;
+
+        std::string error;
+        ASSERT_TRUE(saved.save(path, error)) << error;
+
+        ProveV0Checkpoint loaded;
+        ASSERT_TRUE(loaded.load(path, error)) << error;
+
+        EXPECT_EQ(saved.content.body, loaded.content.body);
+        EXPECT_EQ(saved.content.userId, loaded.content.userId);
+        EXPECT_EQ(saved.content.context, loaded.content.context);
+        EXPECT_EQ(saved.K.toString(), loaded.K.toString());
+        EXPECT_EQ(saved.blockSize, loaded.blockSize);
+        EXPECT_EQ(saved.cursor, loaded.cursor);
+        ASSERT_EQ(saved.pending.size(), loaded.pending.size());
+
+        for (size_t i = 0; i < saved.pending.size(); i++)
+        {
+            EXPECT_EQ(saved.pending.at(i).begin, loaded.pending.at(i).begin);
+            EXPECT_EQ(saved.pending.at(i).end, loaded.pending.at(i).end);
+        }
+
+        EXPECT_EQ(saved.hashes, loaded.hashes);
+        EXPECT_EQ(saved.best.proof, loaded.best.proof);
+        EXPECT_EQ(saved.best.diff, loaded.best.diff);
+        EXPECT_EQ(saved.best.hash.toString(), loaded.best.hash.toString());
+
+        std::filesystem::remove(path);
+    }
+
+    TEST(TestProveV0Checkpoint, RejectsMalformed)
+    {
+        const std::string path =
+            (std::filesystem::temp_directory_path() / "wxpowertest_bad.ckpt").string();
+
+        ProveV0Checkpoint saved;
+        saved.blockSize = 16;
+        saved.content.body = "Hello world!";
+
+        std::string error;
+        ASSERT_TRUE(saved.save(path, error)) << error;
+
+        std::string contents;
+
+        // Scope
+        {
+            std::ifstream in(path, std::ios::binary);
+            contents.assign(std::istreambuf_iterator<char>(in), {});
+        }
+
+        // Truncate anywhere before "end"; none of these may load
+        for (size_t len = 0; (len + 4) < contents.size(); len++)
+        {
+            // Scope
+            {
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                out << contents.substr(0, len);
+            }
+
+            ProveV0Checkpoint loaded;
+            EXPECT_FALSE(loaded.load(path, error)) << len;
+        }
+
+        std::filesystem::remove(path);
+        EXPECT_FALSE(ProveV0Checkpoint().load(path, error));
+    }
+
+    // Starts a light-mode prove job on two hash threads
+    static std::unique_ptr<ProveV0Manager> startLightProve(
+        const PowerV0::ProofContent& content, ProveV0Options options,
+        const std::optional<double>& timeLimit = std::nullopt)
+    {
+        options.rxMode = RxMode::light;
+
+        return std::make_unique<ProveV0Manager>(content, std::vector<u32>{ 0 },
+            std::vector<u32>{ 0, 0 }, false, std::nullopt, timeLimit, options);
+    }
+
+    static u64 totalHashes(const ProveV0Manager& mgr)
+    {
+        u64 total = 0;
+
+        for (u64 h : mgr.getThreadGuardedData().hashes)
+            total += h;
+
+        return total;
+    }
+
+    /* Waits until thread `tid` (or all threads if unset) has published at
+       least `hashes` hashes this run. False if the job ended first or it
+       took over a minute. Polls `masterFinished` rather than `getState`,
+       whose debug checks aren't safe while RX init is wrapping up. */
+    static bool waitForHashes(ProveV0Manager& mgr, u64 hashes,
+        const std::optional<u32>& tid = std::nullopt)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            if (mgr.getMasterGuardedData().masterFinished)
+                return false;
+
+            const u64 done = tid.has_value() ?
+                mgr.getThreadGuardedData().hashes.at(tid.value()) : totalHashes(mgr);
+
+            if (done >= hashes)
+                return true;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        return false;
+    }
+
+    /* Nonces a checkpoint counts as searched. Equals its hash count exactly
+       when no nonce was skipped or hashed twice. */
+    static u64 searchedNonces(const ProveV0Checkpoint& ckpt)
+    {
+        u64 searched = ckpt.cursor;
+
+        for (const NonceScheduler::Range& r : ckpt.pending)
+            searched -= r.end - r.begin;
+
+        return searched;
+    }
+
+    TEST(TestProveV0Checkpoint, ManagerResumes)
+    {
+        const std::string path =
+            (std::filesystem::temp_directory_path() / "wxpowertest_resume.ckpt").string();
+        std::filesystem::remove(path);
+
+        const PowerV0::ProofContent content = { "Resume me", 0, "user", "" };
+        ProveV0Options options;
+        options.checkpointPath = path;
+        options.checkpointInterval = 3600.0;
+        options.nonceBlockSize = 64;
+
+        std::string error;
+        ProveV0Checkpoint first;
+
+        // Scope
+        {
+            std::unique_ptr<ProveV0Manager> mgr = startLightProve(content, options);
+            ASSERT_TRUE(waitForHashes(*mgr, 300));
+            mgr->cancel();
+            mgr.reset();
+
+            ASSERT_TRUE(first.load(path, error)) << error;
+        }
+
+        EXPECT_GE(first.hashes, 300u);
+        EXPECT_EQ(first.hashes, searchedNonces(first));
+
+        ProveV0Checkpoint second;
+
+        // Scope
+        {
+            std::unique_ptr<ProveV0Manager> mgr = startLightProve(content, options);
+            ASSERT_TRUE(waitForHashes(*mgr, 300));
+
+            const ProveV0Manager::MasterGuarded data = mgr->getMasterGuardedData();
+            EXPECT_TRUE(data.warnings.empty());
+            EXPECT_EQ(std::optional<u64>(first.hashes), data.resumedHashes);
+            EXPECT_GE(mgr->getThreadGuardedData().bestDiff.at(0), first.best.diff);
+
+            mgr->cancel();
+            mgr.reset();
+
+            ASSERT_TRUE(second.load(path, error)) << error;
+        }
+
+        /* Had the second run started at nonce zero or hashed any block the
+           first one had, the counts couldn't match. */
+        EXPECT_GT(second.hashes, first.hashes);
+        EXPECT_EQ(second.hashes, searchedNonces(second));
+        EXPECT_GE(second.cursor, first.cursor);
+        EXPECT_GE(second.best.diff, first.best.diff);
+
+        // Either mismatch starts afresh
+        PowerV0::ProofContent otherContent = content;
+        otherContent.body = "Something else";
+        ProveV0Options otherOptions = options;
+        otherOptions.nonceBlockSize = 128;
+
+        const std::pair<PowerV0::ProofContent, ProveV0Options> mismatches[] = {
+            { otherContent, options }, { content, otherOptions } };
+
+        const std::string mismatchWarnings[] = {
+            "Checkpoint is for different content; starting afresh.",
+            "Checkpoint used a different nonce block size; starting afresh." };
+
+        for (size_t i = 0; i < 2; i++)
+        {
+            ASSERT_TRUE(second.save(path, error)) << error;
+
+            std::unique_ptr<ProveV0Manager> mgr =
+                startLightProve(mismatches[i].first, mismatches[i].second);
+            ASSERT_TRUE(waitForHashes(*mgr, 1));
+
+            const ProveV0Manager::MasterGuarded data = mgr->getMasterGuardedData();
+            EXPECT_EQ(std::vector<std::string>{ mismatchWarnings[i] }, data.warnings);
+            EXPECT_FALSE(data.resumedHashes.has_value());
+
+            mgr->cancel();
+            mgr.reset();
+
+            ProveV0Checkpoint fresh;
+            ASSERT_TRUE(fresh.load(path, error)) << error;
+            EXPECT_EQ(mismatches[i].first.body, fresh.content.body);
+            EXPECT_EQ(mismatches[i].second.nonceBlockSize, fresh.blockSize);
+            EXPECT_EQ(fresh.hashes, searchedNonces(fresh));
+        }
+
+        std::filesystem::remove(path);
+    }
+
+    TEST(TestProveV0Checkpoint, KeptOnFinish)
+    {
+        const std::string path =
+            (std::filesystem::temp_directory_path() / "wxpowertest_finish.ckpt").string();
+        std::filesystem::remove(path);
+
+        const PowerV0::ProofContent content = { "Finish me", 0, "user", "" };
+        ProveV0Options options;
+        options.checkpointPath = path;
+        options.checkpointInterval = 3600.0;
+        options.nonceBlockSize = 64;
+
+        for (bool deleteOnFinish : { false, true })
+        {
+            options.deleteCheckpointOnFinish = deleteOnFinish;
+
+            std::unique_ptr<ProveV0Manager> mgr = startLightProve(content, options, 0.5);
+            ASSERT_TRUE(waitForHashes(*mgr, 1));
+
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+
+            while (!mgr->getMasterGuardedData().masterFinished &&
+                (std::chrono::steady_clock::now() < deadline))
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+            EXPECT_EQ(ProveV0Manager::State::finished, mgr->getState());
+            mgr.reset();
+
+            EXPECT_EQ(!deleteOnFinish, std::filesystem::exists(path));
+        }
+
+        std::filesystem::remove(path);
+    }
+
+    TEST(TestProveV0Manager, ActiveThreads)
+    {
+        const std::string path =
+            (std::filesystem::temp_directory_path() / "wxpowertest_threads.ckpt").string();
+        std::filesystem::remove(path);
+
+        /* Blocks too big to ever finish, so each thread keeps to the one it
+           was handed and any other block taken shows in the cursor. */
+        const u64 blockSize = u64(1) << 40;
+
+        const PowerV0::ProofContent content = { "Park me", 0, "user", "" };
+        ProveV0Options options;
+        options.checkpointPath = path;
+        options.checkpointInterval = 3600.0;
+        options.nonceBlockSize = blockSize;
+
+        std::unique_ptr<ProveV0Manager> mgr = startLightProve(content, options);
+        ASSERT_TRUE(waitForHashes(*mgr, 100, 1));
+
+        const std::optional<double> rxTime = mgr->getMasterGuardedData().rxTime;
+        ASSERT_TRUE(rxTime.has_value());
+
+        mgr->setActiveThreads(1);
+        EXPECT_EQ(1u, mgr->getActiveThreads());
+
+        // Wait for thread 1 to park and publish its final count
+        u64 parked = mgr->getThreadGuardedData().hashes.at(1);
+
+        for (u32 still = 0; still < 10; )
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+            const u64 now = mgr->getThreadGuardedData().hashes.at(1);
+            still = (now == parked) ? (still + 1) : 0;
+            parked = now;
+        }
+
+        // Thread 0 carries on alone
+        const u64 hashes0 = mgr->getThreadGuardedData().hashes.at(0);
+        ASSERT_TRUE(waitForHashes(*mgr, hashes0 + 1000, 0));
+        EXPECT_EQ(parked, mgr->getThreadGuardedData().hashes.at(1));
+
+        mgr->setActiveThreads(2);
+        ASSERT_TRUE(waitForHashes(*mgr, parked + 100, 1));
+
+        // Resumed on the same VMs; RX wasn't set up again
+        EXPECT_EQ(ProveV0Manager::State::hashing, mgr->getState());
+        EXPECT_EQ(rxTime, mgr->getMasterGuardedData().rxTime);
+
+        mgr->cancel();
+        mgr.reset();
+
+        ProveV0Checkpoint ckpt;
+        std::string error;
+        ASSERT_TRUE(ckpt.load(path, error)) << error;
+
+        /* Thread 1 got the rest of its own block back instead of a third
+           one, and nothing in it was skipped or hashed twice. */
+        EXPECT_EQ(2 * blockSize, ckpt.cursor);
+        EXPECT_EQ(2u, ckpt.pending.size());
+        EXPECT_EQ(ckpt.hashes, searchedNonces(ckpt));
+
+        std::filesystem::remove(path);
+    }
+
+    TEST(TestSha256, SanityChecks)
+    {
+        Sha256 obj;
+
+        std::string toHash = "Hello world!";
+        Bigint ret = obj.doHash(toHash.c_str(), static_cast<u32>(toHash.size()));
+
+        ASSERT_STREQ(
+            ret.toString().c_str(),
+            "c0535e4be2b79ffd93291305436bf889314e4a3faec05ecffcbb7df31ad9e51a");
+
+        toHash = "304";
+        ret = obj.doHash(toHash.c_str(), static_cast<u32>(toHash.size()));
+
+        ASSERT_STREQ(
+            ret.toString().c_str(),
+            "d874e4e4a5df21173b0f83e313151f813bea4f488686efe670ae47f87c177595");
+    }
+
+    // Proofs which don't parse never reach RX
+    TEST(TestBatchVerifierV0, Unparsable)
+    {
+        BatchVerifierV0 batch(false, 4);
+
+        EXPECT_TRUE(batch.verify(std::vector<std::string>()).empty());
+        EXPECT_EQ(batch.getLastGroupCount(), 0u);
+
+        const std::vector<std::string> proofs = {
+            "", "Hello world!", "Hello world!|wxPoW1|qwerty|uiop", "|wxPoW0||"
+        };
+        const std::vector<BatchVerifierV0::Result> results = batch.verify(proofs);
+
+        ASSERT_EQ(results.size(), proofs.size());
+        EXPECT_EQ(batch.getLastGroupCount(), 0u);
+
+        for (const BatchVerifierV0::Result& result : results)
+        {
+            EXPECT_FALSE(result.parsed);
+            EXPECT_FALSE(result.res.has_value());
+            EXPECT_TRUE(result.prettyMetaData.empty());
+            EXPECT_TRUE(result.error.empty());
+        }
+    }
+
+    /* One cache per distinct K, and results in the order given however the
+       proofs were grouped. Light mode, so a cache init per K is all it costs. */
+    TEST(TestBatchVerifierV0, GroupsByK)
+    {
+        BatchVerifierV0 batch(false, 2, 0, false);
+
+        const std::vector<std::string> proofs = {
+            "one|wxPoW0|alice|x", "garbage", "two|wxPoW0|bob|x",
+            "three|wxPoW0|alice|x", "|wxPoW0||", "four|wxPoW0|bob|x"
+        };
+        const std::vector<BatchVerifierV0::Result> results = batch.verify(proofs);
+
+        ASSERT_EQ(results.size(), proofs.size());
+        EXPECT_EQ(batch.getLastGroupCount(), 2u);
+        EXPECT_EQ(batch.getLastFullGroupCount(), 0u);
+
+        PowerV0 power;
+
+        for (size_t i = 0; i < proofs.size(); i++)
+        {
+            std::optional<HashResult> res;
+            std::string prettyMetaData;
+            std::string error;
+            const bool parsed = power.verifyMessage(
+                proofs[i], false, res, prettyMetaData, error);
+
+            ASSERT_EQ(results[i].parsed, parsed) << proofs[i];
+            ASSERT_EQ(results[i].res.has_value(), res.has_value()) << proofs[i];
+            EXPECT_EQ(results[i].prettyMetaData, prettyMetaData);
+            EXPECT_EQ(results[i].error, error);
+
+            if (res.has_value())
+            {
+                EXPECT_EQ(results[i].res->hash.toString(), res->hash.toString()) << proofs[i];
+                EXPECT_EQ(results[i].res->diff, res->diff);
+                EXPECT_EQ(results[i].res->proof, res->proof);
+                EXPECT_TRUE(results[i].content.body.empty());
+            }
+        }
+
+        // Sharing a K doesn't mean sharing a hash
+        EXPECT_NE(results[0].res->hash.toString(), results[3].res->hash.toString());
+    }
+
+    TEST(TestBatchVerifierV0, BreakEven)
+    {
+        BatchVerifierV0::Calibration calibration;
+        calibration.lightHash = 0.5;
+        calibration.fullHash = 0.25;
+        calibration.datasetBuild = 8;
+
+        // 8 s of dataset build pays for itself after 32 hashes a thread
+        EXPECT_EQ(BatchVerifierV0::getBreakEven(calibration, 1), 32u);
+        EXPECT_EQ(BatchVerifierV0::getBreakEven(calibration, 4), 128u);
+
+        // Rounded up
+        calibration.datasetBuild = 8.125;
+        EXPECT_EQ(BatchVerifierV0::getBreakEven(calibration, 1), 33u);
+
+        // Full mode never pays
+        calibration.datasetBuild = std::numeric_limits<double>::infinity();
+        EXPECT_EQ(BatchVerifierV0::getBreakEven(calibration, 1), SIZE_MAX);
+
+        calibration.datasetBuild = 1e30;
+        EXPECT_EQ(BatchVerifierV0::getBreakEven(calibration, 1), SIZE_MAX);
+
+        calibration.datasetBuild = 8;
+        calibration.fullHash = 0.5;
+        EXPECT_EQ(BatchVerifierV0::getBreakEven(calibration, 1), SIZE_MAX);
+
+        calibration.fullHash = 0.75;
+        EXPECT_EQ(BatchVerifierV0::getBreakEven(calibration, 1), SIZE_MAX);
+    }
+
+    TEST(TestBatchVerifierV0, FormatResult)
+    {
+        BatchVerifierV0::Result result;
+        EXPECT_EQ(BatchVerifierV0::formatResult(result), "{\"status\":\"invalid\"}");
+
+        result.parsed = true;
+        result.content = { "body", 0, "me", "\"x\"" };
+        result.error = "Failed.";
+        EXPECT_EQ(BatchVerifierV0::formatResult(result),
+            "{\"status\":\"error\",\"error\":\"Failed.\"}");
+
+        result.res.emplace();
+        ASSERT_TRUE(Bigint::fromString(std::string(63, '0') + "1", result.res->hash));
+        result.res->diff = 255;
+
+        EXPECT_EQ(BatchVerifierV0::formatResult(result),
+            "{\"status\":\"ok\",\"diff\":255,\"hash\":\"" + std::string(63, '0') +
+            "1\",\"userId\":\"me\",\"context\":\"\\\"x\\\"\"}");
+    }
+
+    // Unparsable proofs, and any cancelled before they start, never reach RX
+    TEST(TestAsyncVerifierV0, Future)
+    {
+        AsyncVerifierV0 verifier(2, 1);
+
+        const std::shared_ptr<AsyncVerifierV0::Job> job =
+            verifier.submit({ "garbage", "|wxPoW0||" }, false);
+        const AsyncVerifierV0::Results results = job->getFuture().get();
+
+        ASSERT_EQ(results.size(), 2u);
+        EXPECT_FALSE(results[0].parsed);
+        EXPECT_FALSE(results[1].parsed);
+
+        EXPECT_TRUE(job->isStarted());
+        EXPECT_FALSE(job->isCancelled());
+        EXPECT_EQ(job->getDone(), 2u);
+        EXPECT_EQ(job->getTotal(), 2u);
+    }
+
+    TEST(TestAsyncVerifierV0, Callback)
+    {
+        AsyncVerifierV0 verifier(1, 1);
+        std::promise<size_t> called;
+        std::future<size_t> calledFuture = called.get_future();
+
+        // Mustn't take the worker down
+        const std::shared_ptr<AsyncVerifierV0::Job> thrower = verifier.submit({ "garbage" }, false,
+            [](const AsyncVerifierV0::Results&) { throw std::runtime_error("callback"); });
+
+        verifier.submit({ "a", "b", "c" }, false,
+            [&called](const AsyncVerifierV0::Results& results) { called.set_value(results.size()); });
+
+        EXPECT_EQ(thrower->getFuture().get().size(), 1u);
+        ASSERT_EQ(calledFuture.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        EXPECT_EQ(calledFuture.get(), 3u);
+    }
+
+    TEST(TestAsyncVerifierV0, CancelBeforeStart)
+    {
+        AsyncVerifierV0 verifier(1, 1);
+        std::promise<void> release;
+        const std::shared_future<void> released = release.get_future().share();
+
+        // Holds the only worker in its callback, so the next job stays queued
+        verifier.submit({ "garbage" }, false,
+            [released](const AsyncVerifierV0::Results&) { released.wait(); });
+
+        const std::shared_ptr<AsyncVerifierV0::Job> job =
+            verifier.submit({ "Hello world!|wxPoW0|me|here", "garbage" }, false);
+
+        job->cancel();
+        EXPECT_FALSE(job->isStarted());
+        EXPECT_GE(verifier.getQueued(), 1u);
+
+        release.set_value();
+
+        const AsyncVerifierV0::Results results = job->getFuture().get();
+
+        ASSERT_EQ(results.size(), 2u);
+        EXPECT_TRUE(results[0].parsed);
+        EXPECT_FALSE(results[0].res.has_value());
+        EXPECT_EQ(results[0].error, "Verification cancelled.");
+        EXPECT_FALSE(results[1].parsed);
+        EXPECT_TRUE(job->isCancelled());
+    }
+
+    TEST(TestProofExtractorV0, FindMagic)
+    {
+        EXPECT_TRUE(ProofExtractorV0::findMagic("").empty());
+        EXPECT_EQ(ProofExtractorV0::findMagic("|wxPoW0|wxPoW0|"), (std::vector<size_t>{ 0, 7 }));
+
+        // Every alignment, near both ends, against a plain search
+        std::mt19937 rng(99);
+
+        for (u32 i = 0; i < 2000; i++)
+        {
+            std::string doc(rng() % 80, 'x');
+
+            for (u32 j = rng() % 4; j > 0; j--)
+            {
+                const size_t pos = rng() % (doc.size() + 1);
+                doc.insert(pos, (rng() % 2) ? "|wxPoW0|" : "|wxPoW1|");
+            }
+
+            std::vector<size_t> expected;
+
+            for (size_t pos = doc.find(PowerV0::magicSequence); pos != std::string::npos;
+                pos = doc.find(PowerV0::magicSequence, pos + 1))
+                expected.push_back(pos);
+
+            ASSERT_EQ(ProofExtractorV0::findMagic(doc), expected) << doc;
+        }
+    }
+
+    TEST(TestProofExtractorV0, Extract)
+    {
+        const ProofExtractorV0 extractor(ProofExtractorV0::separatedBy("<hr>"));
+        const std::string doc =
+            "<p>first|wxPoW0|a|b</p><hr>unsigned<hr>"
+            "<p>second|wxPoW0|c|d</p> quoting |wxPoW0|e|f<hr>third|wxPoW0|g|";
+
+        const std::vector<std::string_view> records = extractor.extract(doc);
+
+        ASSERT_EQ(records.size(), 3u);
+        EXPECT_EQ(records[0], "<p>first|wxPoW0|a|b</p>");
+        EXPECT_EQ(records[1], "<p>second|wxPoW0|c|d</p> quoting |wxPoW0|e|f");
+        EXPECT_EQ(records[2], "third|wxPoW0|g|");
+
+        // Views into the document itself
+        EXPECT_EQ(records[0].data(), doc.data());
+
+        const ProofExtractorV0 whole(ProofExtractorV0::separatedBy(""));
+        EXPECT_EQ(whole.extract(doc), std::vector<std::string_view>{ doc });
+        EXPECT_TRUE(whole.extract("no proofs here").empty());
+
+        BatchVerifierV0 batch(false, 2);
+        const std::vector<BatchVerifierV0::Result> results = batch.verify(
+            std::vector<std::string_view>{ "Hello world!", "|wxPoW0||" });
+
+        ASSERT_EQ(results.size(), 2u);
+        EXPECT_FALSE(results[0].parsed);
+        EXPECT_FALSE(results[1].parsed);
+    }
+
+    TEST(TestRxScalingBenchmark, DefaultCoreCounts)
+    {
+        EXPECT_TRUE(RxScalingBenchmark::defaultCoreCounts(0).empty());
+        EXPECT_EQ(RxScalingBenchmark::defaultCoreCounts(1), (std::vector<u32>{ 1 }));
+        EXPECT_EQ(RxScalingBenchmark::defaultCoreCounts(8), (std::vector<u32>{ 1, 2, 4, 8 }));
+        EXPECT_EQ(RxScalingBenchmark::defaultCoreCounts(12), (std::vector<u32>{ 1, 2, 4, 8, 12 }));
+    }
+
+    TEST(TestRxScalingBenchmark, Format)
+    {
+        RxScalingBenchmark::Report report;
+        RxScalingBenchmark::Curve curve;
+
+        curve.largePages = true;
+        curve.datasetBuild = 5;
+        curve.hash.push_back({ 1, 1000, 1000, 1 });
+        curve.hash.push_back({ 2, 1500, 750, 0.75 });
+
+        report.curves.push_back(curve);
+        report.warnings.push_back("\"x\"");
+
+        EXPECT_EQ(RxScalingBenchmark::formatJson(report),
+            "{\"curves\":[{\"largePages\":true,\"datasetBuild\":5,\"init\":[],\"hash\":["
+            "{\"cores\":1,\"rate\":1000,\"perCore\":1000,\"efficiency\":1},"
+            "{\"cores\":2,\"rate\":1500,\"perCore\":750,\"efficiency\":0.75}]}],"
+            "\"warnings\":[\"\\\"x\\\"\"]}");
+
+        const std::string text = RxScalingBenchmark::formatText(report);
+
+        EXPECT_NE(text.find("Large pages; whole dataset built in 5.00 s"), std::string::npos);
+        EXPECT_NE(text.find("         2      1500.0       750.0       75.0%"), std::string::npos);
+        EXPECT_NE(text.find("Warning: \"x\""), std::string::npos);
+    }
+
+    TEST(TestRxCachePool, Budget)
+    {
+        RxCachePool& pool = RxCachePool::instance();
+        const u64 budget = pool.getBudget();
+
+        pool.setBudget(3 * RxCache::getBytes() - 1);
+        EXPECT_EQ(pool.getCapacity(), 2u);
+
+        pool.setBudget(RxCache::getBytes() - 1);
+        EXPECT_EQ(pool.getCapacity(), 0u);
+        EXPECT_EQ(pool.getUsedBytes(), 0u);
+
+        pool.setBudget(budget);
+
+        RxCachePool::Stats stats;
+        EXPECT_EQ(stats.getHitRate(), 0);
+
+        stats.hits = 3;
+        stats.misses = 1;
+        EXPECT_EQ(stats.getHitRate(), 0.75);
+    }
+
+    /* Empties the shared pool and gives it room for `caches`, returning the
+       budget it had */
+    static u64 resetCachePool(u32 caches)
+    {
+        RxCachePool& pool = RxCachePool::instance();
+        const u64 budget = pool.getBudget();
+
+        pool.setBudget(0);
+        pool.setBudget(caches * RxCache::getBytes());
+        pool.resetStats();
+
+        return budget;
+    }
+
+    static Bigint cachePoolTestK(u32 i)
+    {
+        Bigint K;
+        EXPECT_TRUE(Bigint::fromString(std::string(63, '0') + std::to_string(i), K));
+
+        return K;
+    }
+
+    TEST(TestRxCachePool, HitsAndEviction)
+    {
+        RxCachePool& pool = RxCachePool::instance();
+        const u64 budget = resetCachePool(2);
+        bool hit = true;
+
+        randomx_cache* second = nullptr;
+
+        EXPECT_EQ(pool.acquire(cachePoolTestK(1), false, hit)->getK().toString(),
+            cachePoolTestK(1).toString());
+        EXPECT_FALSE(hit);
+
+        second = pool.acquire(cachePoolTestK(2), false, hit)->get();
+        EXPECT_FALSE(hit);
+
+        // Makes K 2 the least recently used
+        pool.acquire(cachePoolTestK(1), false, hit);
+        EXPECT_TRUE(hit);
+        EXPECT_EQ(pool.getUsedBytes(), 2 * RxCache::getBytes());
+
+        // Pushes out K 2, reinitializing its cache in place
+        EXPECT_EQ(pool.acquire(cachePoolTestK(3), false, hit)->get(), second);
+        EXPECT_FALSE(hit);
+
+        pool.acquire(cachePoolTestK(1), false, hit);
+        EXPECT_TRUE(hit);
+
+        pool.acquire(cachePoolTestK(2), false, hit);
+        EXPECT_FALSE(hit);
+
+        const RxCachePool::Stats stats = pool.getStats();
+        EXPECT_EQ(stats.hits, 2u);
+        EXPECT_EQ(stats.misses, 4u);
+        EXPECT_EQ(stats.evictions, 2u);
+        EXPECT_EQ(stats.recycled, 2u);
+        EXPECT_EQ(pool.getUsedBytes(), 2 * RxCache::getBytes());
+
+        pool.setBudget(budget);
+    }
+
+    // With every cache pinned, a new K waits for one to be let go
+    TEST(TestRxCachePool, WaitsWhilePinned)
+    {
+        RxCachePool& pool = RxCachePool::instance();
+        const u64 budget = resetCachePool(1);
+        bool hit = true;
+
+        std::shared_ptr<RxCache> pinned = pool.acquire(cachePoolTestK(1), false, hit);
+        randomx_cache* const memory = pinned->get();
+
+        std::future<randomx_cache*> waiting = std::async(std::launch::async, [&pool]()
+        {
+            bool waitingHit = true;
+            const std::shared_ptr<RxCache> cache =
+                pool.acquire(cachePoolTestK(2), false, waitingHit);
+
+            EXPECT_FALSE(waitingHit);
+            EXPECT_EQ(cache->getK().toString(), cachePoolTestK(2).toString());
+
+            return cache->get();
+        });
+
+        EXPECT_EQ(waiting.wait_for(std::chrono::milliseconds(200)), std::future_status::timeout);
+        EXPECT_EQ(pool.getUsedBytes(), RxCache::getBytes());
+
+        pinned.reset();
+        EXPECT_EQ(waiting.get(), memory);
+        EXPECT_EQ(pool.getStats().recycled, 1u);
+
+        pool.setBudget(budget);
+    }
+
+    // Callers wanting the same K share one initialization
+    TEST(TestRxCachePool, ConcurrentSameK)
+    {
+        RxCachePool& pool = RxCachePool::instance();
+        const u64 budget = resetCachePool(1);
+        std::vector<std::future<randomx_cache*>> callers;
+
+        for (u32 i = 0; i < 4; i++)
+        {
+            callers.push_back(std::async(std::launch::async, [&pool]()
+            {
+                bool hit = false;
+                return pool.acquire(cachePoolTestK(7), false, hit)->get();
+            }));
+        }
+
+        randomx_cache* const first = callers[0].get();
+
+        for (size_t i = 1; i < callers.size(); i++)
+            EXPECT_EQ(callers[i].get(), first);
+
+        const RxCachePool::Stats stats = pool.getStats();
+        EXPECT_EQ(stats.misses, 1u);
+        EXPECT_EQ(stats.hits, 3u);
+
+        pool.setBudget(budget);
+    }
+
+    // Below one cache nothing is pooled
+    TEST(TestRxCachePool, Unpooled)
+    {
+        RxCachePool& pool = RxCachePool::instance();
+        const u64 budget = resetCachePool(0);
+        bool hit = true;
+
+        const std::shared_ptr<RxCache> a = pool.acquire(cachePoolTestK(1), false, hit);
+        EXPECT_FALSE(hit);
+
+        const std::shared_ptr<RxCache> b = pool.acquire(cachePoolTestK(1), false, hit);
+        EXPECT_FALSE(hit);
+
+        EXPECT_NE(a->get(), b->get());
+        EXPECT_EQ(pool.getUsedBytes(), 0u);
+        EXPECT_EQ(pool.getStats().misses, 2u);
+
+        pool.setBudget(budget);
+    }
+
+    // Allocation only; nothing is initialized, so no dataset memory is touched
+    static std::shared_ptr<RxDataset> allocTestDataset(const Bigint& K)
+    {
+        const std::shared_ptr<RxDataset> dataset = RxDataset::alloc(K, randomx_get_flags());
+        EXPECT_TRUE(dataset);
+
+        return dataset;
+    }
+
+    TEST(TestRxDataset, DoneChunks)
+    {
+        const std::shared_ptr<RxDataset> dataset = allocTestDataset(Bigint());
+        ASSERT_TRUE(dataset);
+
+        const u64 itemCount = randomx_dataset_item_count();
+        const u64 chunkCount = RxDataset::getChunkCount();
+
+        ASSERT_EQ(chunkCount, (itemCount + RxDataset::initChunkItems - 1) / RxDataset::initChunkItems);
+        ASSERT_GE(chunkCount, 2u);
+
+        EXPECT_FALSE(dataset->isComplete());
+        EXPECT_EQ(dataset->getDoneItems(), 0u);
+
+        // The last chunk may be short
+        const u64 lastItems = itemCount - (chunkCount - 1) * RxDataset::initChunkItems;
+
+        dataset->markChunkDone(chunkCount - 1);
+        EXPECT_TRUE(dataset->isChunkDone(chunkCount - 1));
+        EXPECT_FALSE(dataset->isChunkDone(0));
+        EXPECT_EQ(dataset->getDoneItems(), lastItems);
+
+        // Marking twice counts once
+        dataset->markChunkDone(0);
+        dataset->markChunkDone(0);
+        EXPECT_EQ(dataset->getDoneItems(), lastItems + RxDataset::initChunkItems);
+        EXPECT_FALSE(dataset->isComplete());
+
+        for (u64 chunk = 0; chunk < chunkCount; chunk++)
+            dataset->markChunkDone(chunk);
+
+        EXPECT_TRUE(dataset->isComplete());
+        EXPECT_EQ(dataset->getDoneItems(), itemCount);
+
+        const std::shared_ptr<RxDataset> other = allocTestDataset(Bigint());
+        ASSERT_TRUE(other);
+
+        other->markAllDone();
+        EXPECT_TRUE(other->isComplete());
+        EXPECT_EQ(other->getDoneItems(), itemCount);
+    }
+
+    /* A partly built dataset goes to one caller, to finish, and leaves the
+       cache meanwhile; a finished one stays and is shared */
+    TEST(TestRxDatasetCache, PartialHandout)
+    {
+        RxDatasetCache& cache = RxDatasetCache::instance();
+        const u64 budget = cache.getBudget();
+
+        cache.setBudget(0);
+        cache.setBudget(2 * RxDataset::getBytes());
+
+        Bigint K;
+        ASSERT_TRUE(Bigint::fromString(std::string(64, 'c'), K));
+
+        // Scope
+        {
+            const std::shared_ptr<RxDataset> partial = allocTestDataset(K);
+            ASSERT_TRUE(partial);
+
+            partial->markChunkDone(0);
+            cache.insert(partial);
+        }
+
+        EXPECT_EQ(cache.getUsedBytes(), RxDataset::getBytes());
+        EXPECT_FALSE(cache.contains(K));
+
+        std::shared_ptr<RxDataset> resumed = cache.acquire(K);
+        ASSERT_TRUE(resumed);
+        EXPECT_TRUE(resumed->isChunkDone(0));
+        EXPECT_FALSE(resumed->isComplete());
+
+        // Nobody else gets it while it's being finished
+        EXPECT_EQ(cache.getUsedBytes(), 0u);
+        EXPECT_FALSE(cache.acquire(K));
+
+        resumed->markAllDone();
+        cache.insert(resumed);
+        EXPECT_TRUE(cache.contains(K));
+
+        EXPECT_EQ(cache.acquire(K), resumed);
+        EXPECT_EQ(cache.acquire(K), resumed);
+        EXPECT_EQ(cache.getUsedBytes(), RxDataset::getBytes());
+
+        resumed.reset();
+        cache.setBudget(0);
+        cache.setBudget(budget);
+    }
+
+    // A finished dataset for a K made of `digit`, allocated but not built
+    static std::shared_ptr<RxDataset> finishedTestDataset(char digit)
+    {
+        Bigint K;
+        EXPECT_TRUE(Bigint::fromString(std::string(64, digit), K));
+
+        const std::shared_ptr<RxDataset> dataset = allocTestDataset(K);
+
+        if (dataset)
+            dataset->markAllDone();
+
+        return dataset;
+    }
+
+    // Empties the shared cache and gives it room for `datasets`, returning the old budget
+    static u64 resetDatasetCache(u64 datasets)
+    {
+        RxDatasetCache& cache = RxDatasetCache::instance();
+        const u64 budget = cache.getBudget();
+
+        cache.setBudget(0);
+        cache.setBudget(datasets * RxDataset::getBytes());
+
+        return budget;
+    }
+
+    TEST(TestRxDatasetCache, Budget)
+    {
+        RxDatasetCache& cache = RxDatasetCache::instance();
+        const u64 budget = resetDatasetCache(2);
+        const u64 bytes = RxDataset::getBytes();
+
+        cache.insert(finishedTestDataset('1'));
+        cache.insert(finishedTestDataset('2'));
+        EXPECT_EQ(cache.getUsedBytes(), 2 * bytes);
+
+        // A second insert for the same K is ignored
+        cache.insert(finishedTestDataset('2'));
+        EXPECT_EQ(cache.getUsedBytes(), 2 * bytes);
+
+        cache.insert(finishedTestDataset('3'));
+        EXPECT_EQ(cache.getUsedBytes(), 2 * bytes);
+        EXPECT_FALSE(cache.contains(finishedTestDataset('1')->K));
+
+        // Lowering the budget drops what no longer fits
+        cache.setBudget(bytes);
+        EXPECT_EQ(cache.getUsedBytes(), bytes);
+
+        // Nothing is kept if even one dataset doesn't fit
+        cache.setBudget(bytes - 1);
+        EXPECT_EQ(cache.getUsedBytes(), 0u);
+
+        cache.insert(finishedTestDataset('4'));
+        EXPECT_EQ(cache.getUsedBytes(), 0u);
+
+        cache.setBudget(budget);
+    }
+
+    TEST(TestRxDatasetCache, LeastRecentlyUsed)
+    {
+        RxDatasetCache& cache = RxDatasetCache::instance();
+        const u64 budget = resetDatasetCache(2);
+        const std::shared_ptr<RxDataset> probe1 = finishedTestDataset('1');
+        const std::shared_ptr<RxDataset> probe2 = finishedTestDataset('2');
+
+        cache.insert(finishedTestDataset('1'));
+        cache.insert(finishedTestDataset('2'));
+
+        // Using the older one makes the other the one to go
+        EXPECT_TRUE(cache.acquire(probe1->K));
+        cache.insert(finishedTestDataset('3'));
+
+        EXPECT_TRUE(cache.contains(probe1->K));
+        EXPECT_FALSE(cache.contains(probe2->K));
+
+        // `contains` doesn't count as a use
+        cache.insert(finishedTestDataset('2'));
+        EXPECT_TRUE(cache.contains(probe2->K));
+        EXPECT_FALSE(cache.contains(probe1->K));
+
+        cache.setBudget(0);
+        cache.setBudget(budget);
+    }
+
+    // A dataset someone still holds is never dropped, even over budget
+    TEST(TestRxDatasetCache, KeepsHeld)
+    {
+        RxDatasetCache& cache = RxDatasetCache::instance();
+        const u64 budget = resetDatasetCache(2);
+        const u64 bytes = RxDataset::getBytes();
+
+        std::shared_ptr<RxDataset> held = finishedTestDataset('1');
+        const std::shared_ptr<RxDataset> probe2 = finishedTestDataset('2');
+        const std::shared_ptr<RxDataset> probe3 = finishedTestDataset('3');
+
+        cache.insert(held);
+        cache.insert(finishedTestDataset('2'));
+
+        // The least recently used one is held, so the next goes instead
+        cache.insert(finishedTestDataset('3'));
+        EXPECT_TRUE(cache.contains(held->K));
+        EXPECT_FALSE(cache.contains(probe2->K));
+        EXPECT_TRUE(cache.contains(probe3->K));
+
+        cache.makeRoom(bytes);
+        EXPECT_TRUE(cache.contains(held->K));
+        EXPECT_FALSE(cache.contains(probe3->K));
+        EXPECT_EQ(cache.getUsedBytes(), bytes);
+
+        // Over budget rather than dropping it
+        cache.setBudget(bytes);
+        cache.insert(finishedTestDataset('2'));
+        EXPECT_EQ(cache.getUsedBytes(), 2 * bytes);
+
+        cache.setBudget(0);
+        EXPECT_EQ(cache.getUsedBytes(), bytes);
+        EXPECT_TRUE(cache.contains(held->K));
+
+        // Once let go of, it can be dropped
+        held.reset();
+        cache.trim();
+        EXPECT_EQ(cache.getUsedBytes(), 0u);
+
+        cache.setBudget(budget);
+    }
+
+    /* Snapshot files are checked at the file level with a few KiB standing
+       in for the dataset, so that no dataset needs building */
+    class TestRxDatasetSnapshot : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            dir = std::filesystem::temp_directory_path() / "wxpowertest_snapshots";
+
+            std::filesystem::remove_all(dir);
+            std::filesystem::create_directories(dir);
+
+            data.resize(4096);
+
+            for (size_t i = 0; i < data.size(); i++)
+                data[i] = i * UINT64_C(0x9e3779b97f4a7c15);
+
+            ASSERT_TRUE(Bigint::fromString(std::string(64, 'a'), K));
+        }
+
+        void TearDown() override
+        {
+            std::filesystem::remove_all(dir);
+        }
+
+        u64 dataBytes() const
+        {
+            return data.size() * sizeof(u64);
+        }
+
+        // Whatever `readSnapshotFile` says is wrong with `path`
+        std::string read(const std::string& path, const Bigint& readK)
+        {
+            const std::atomic<bool> cancelled{false};
+            std::vector<u64> copy(data.size());
+            std::string problem;
+
+            if (RxDatasetCache::readSnapshotFile(
+                path, readK, copy.data(), dataBytes(), { 0 }, cancelled, problem))
+            {
+                EXPECT_EQ(copy, data);
+                EXPECT_TRUE(problem.empty());
+            }
+            else
+                EXPECT_FALSE(problem.empty());
+
+            return problem;
+        }
+
+        std::filesystem::path dir;
+        std::vector<u64> data;
+        Bigint K;
+    };
+
+    TEST_F(TestRxDatasetSnapshot, RoundTrip)
+    {
+        const std::string path = (dir / RxDatasetCache::snapshotFileName(K)).string();
+        std::string error;
+
+        ASSERT_TRUE(RxDatasetCache::writeSnapshotFile(path, K, data.data(), dataBytes(), error))
+            << error;
+        EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+        EXPECT_EQ(read(path, K), "");
+
+        // Cancelled before a chunk is copied, which is no fault of the file
+        const std::atomic<bool> cancelled{true};
+        std::vector<u64> copy(data.size());
+
+        EXPECT_FALSE(RxDatasetCache::readSnapshotFile(
+            path, K, copy.data(), dataBytes(), { 0 }, cancelled, error));
+        EXPECT_TRUE(error.empty());
+    }
+
+    TEST_F(TestRxDatasetSnapshot, HeaderMismatch)
+    {
+        const std::string path = (dir / "snapshot.rxds").string();
+        std::string error;
+
+        ASSERT_TRUE(RxDatasetCache::writeSnapshotFile(path, K, data.data(), dataBytes(), error))
+            << error;
+
+        Bigint otherK;
+        ASSERT_TRUE(Bigint::fromString(std::string(64, 'b'), otherK));
+        EXPECT_EQ(read(path, otherK), "is for a different RX configuration");
+
+        // The data size is part of the header too
+        ASSERT_TRUE(RxDatasetCache::writeSnapshotFile(
+            path, K, data.data(), dataBytes() - 32, error)) << error;
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) + 32);
+        EXPECT_EQ(read(path, K), "is for a different RX configuration");
+    }
+
+    TEST_F(TestRxDatasetSnapshot, Corrupt)
+    {
+        const std::string path = (dir / "snapshot.rxds").string();
+        std::string error;
+
+        ASSERT_TRUE(RxDatasetCache::writeSnapshotFile(path, K, data.data(), dataBytes(), error))
+            << error;
+
+        const u64 headerBytes = std::filesystem::file_size(path) - dataBytes();
+        std::string contents;
+
+        // Scope
+        {
+            std::ifstream in(path, std::ios::binary);
+            contents.assign(std::istreambuf_iterator<char>(in), {});
+        }
+
+        // One flipped bit anywhere in the data, first word to last
+        for (const u64 offset : { headerBytes, headerBytes + 1000, headerBytes + dataBytes() - 1 })
+        {
+            std::string damaged = contents;
+            damaged[offset] ^= 0x10;
+
+            // Scope
+            {
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                out << damaged;
+            }
+
+            EXPECT_EQ(read(path, K), "is corrupt") << offset;
+        }
+
+        // Two words swapped
+        std::string swapped = contents;
+        std::swap_ranges(swapped.begin() + headerBytes, swapped.begin() + headerBytes + 8,
+            swapped.begin() + headerBytes + 8);
+
+        // Scope
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out << swapped;
+        }
+
+        EXPECT_EQ(read(path, K), "is corrupt");
+    }
+
+    TEST_F(TestRxDatasetSnapshot, Truncated)
+    {
+        const std::string path = (dir / "snapshot.rxds").string();
+        std::string error;
 
-        seed[0] = 0x08;
-        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(4));
+        ASSERT_TRUE(RxDatasetCache::writeSnapshotFile(path, K, data.data(), dataBytes(), error))
+            << error;
 
-        seed[0] = 0x04;
-        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(5));
+        const u64 bytes = std::filesystem::file_size(path);
 
-        seed[0] = 0x02;
-        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(6));
+        for (const u64 length : { bytes - 8, bytes - dataBytes(), UINT64_C(100) })
+        {
+            std::filesystem::resize_file(path, length);
+            EXPECT_EQ(read(path, K), "has the wrong size") << length;
+        }
 
-        seed[0] = 0x01;
-        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(7));
+        std::filesystem::resize_file(path, 0);
+        EXPECT_EQ(read(path, K), "could not be mapped");
 
-        seed[0] = 0;
-        seed[1] = 0x80;
-        EXPECT_EQ(PowerV0::calcLZCDiff(obj), UINT32_C(8));
+        std::filesystem::remove(path);
+        EXPECT_EQ(read(path, K), "could not be mapped");
     }
 
-    TEST(Test_Bigint_V0, Diff2)
+    // Least recently modified first; other files are left alone
+    TEST_F(TestRxDatasetSnapshot, Eviction)
     {
-        Bigint obj;
-        u8* seed = obj.getBytes();
+        const auto now = std::filesystem::file_time_type::clock::now();
 
-        for (u32 i = 0; i < 32; i++)
-            for (u32 j = 0; j < 8; j++)
+        const auto create = [this, now](const std::string& name, int ageHours)
+        {
+            // Scope
             {
-                memset(seed, 0, 32);
+                std::ofstream out(dir / name, std::ios::binary);
+                out << std::string(100, 'x');
+            }
 
-                seed[i] = UINT8_C(1) << (7 - j);
+            std::filesystem::last_write_time(dir / name, now - std::chrono::hours(ageHours));
+        };
 
-                const u32 expectedDiff = i * 8 + j;
-                const u32 actualDiff = PowerV0::calcLZCDiff(obj);
+        create("a.rxds", 2);
+        create("b.rxds", 3);
+        create("c.rxds", 1);
+        create("other.txt", 4);
 
-                EXPECT_EQ(actualDiff, expectedDiff);
-            }
+        EXPECT_TRUE(RxDatasetCache::evictSnapshots(dir.string(), 100, 400));
+        EXPECT_TRUE(std::filesystem::exists(dir / "b.rxds"));
 
-        {
-            memset(seed, 0, 32);
+        EXPECT_TRUE(RxDatasetCache::evictSnapshots(dir.string(), 100, 300));
+        EXPECT_FALSE(std::filesystem::exists(dir / "b.rxds"));
+        EXPECT_TRUE(std::filesystem::exists(dir / "a.rxds"));
 
-            const u32 expectedDiff = 256;
-            const u32 actualDiff = PowerV0::calcLZCDiff(obj);
+        EXPECT_TRUE(RxDatasetCache::evictSnapshots(dir.string(), 150, 300));
+        EXPECT_FALSE(std::filesystem::exists(dir / "a.rxds"));
+        EXPECT_TRUE(std::filesystem::exists(dir / "c.rxds"));
 
-            EXPECT_EQ(actualDiff, expectedDiff);
-        }
+        // Can't fit however much goes
+        EXPECT_FALSE(RxDatasetCache::evictSnapshots(dir.string(), 400, 300));
+        EXPECT_FALSE(std::filesystem::exists(dir / "c.rxds"));
+        EXPECT_TRUE(std::filesystem::exists(dir / "other.txt"));
     }
 
-    ////////////////////////////////////////////////////////////////////////////
-    ////////////////////////////////////////////////////////////////////////////
-    ////////////////////////////////////////////////////////////////////////////
-
-    class TestB64Ctor32 : public ::testing::TestWithParam<
-        std::tuple<u32, std::string>>
+    TEST(TestJsonEscape, Escapes)
     {
-    public:
-        static const std::vector<std::tuple<u32, std::string>> tests;
-    };
+        EXPECT_EQ(jsonEscape("plain"), "plain");
+        EXPECT_EQ(jsonEscape("a\"b\\c"), "a\\\"b\\\\c");
+        EXPECT_EQ(jsonEscape("\n\r\t"), "\\n\\r\\t");
+        EXPECT_EQ(jsonEscape(std::string("\x01\x1f", 2)), "\\u0001\\u001f");
+        EXPECT_EQ(jsonEscape("\xc3\xa9"), "\xc3\xa9");
+    }
 
-    const std::vector<std::tuple<u32, std::string>> TestB64Ctor32::tests =
+    TEST(TestUnescapeLine, Unescapes)
     {
-        {          0, "A" },
-        {          1, "B" },
-        {         12, "M" },
-        {      0x37e, "-N" },
-        {     0x3cb2, "yyD" },
-        {    0x572db, "bLXB" },
-        {   0x678ec9, "J74Z" },
-        {  0xe67d28b, "LK9ZO" },
-        { 0x57ce65ab, "rWmzXB" },
-        { 0x89abcdef, "v38qJC" },
-        { 0xffffffff, "_____D" }
-    };
+        EXPECT_EQ(unescapeLine("plain"), "plain");
+        EXPECT_EQ(unescapeLine("a\\nb\\rc"), "a\nb\rc");
+        EXPECT_EQ(unescapeLine("a\\\\nb"), "a\\nb");
+        EXPECT_EQ(unescapeLine("\\t\\"), "\\t\\");
+    }
 
-    TEST_P(TestB64Ctor32, TestProper)
+    TEST(TestParseCount, Parses)
     {
-        const std::tuple<u32, std::string>& param = GetParam();
-        const u32 val = std::get<0>(param);
-        const std::string& expected = std::get<1>(param);
+        u64 count = 7;
 
-        Base64 obj(val);
+        EXPECT_TRUE(parseCount("0", count));
+        EXPECT_EQ(count, 0u);
+        EXPECT_TRUE(parseCount("18446744073709551615", count));
+        EXPECT_EQ(count, UINT64_MAX);
+        EXPECT_TRUE(parseCount("4294967295", count, UINT32_MAX));
+        EXPECT_EQ(count, UINT32_MAX);
 
-        ASSERT_EQ(expected, obj.toString());
-    }
+        // None of these may touch `count`
+        count = 7;
 
-    INSTANTIATE_TEST_SUITE_P(
-        ParamTest,
-        TestB64Ctor32,
-        ::testing::ValuesIn(TestB64Ctor32::tests));
+        for (const char* str : { "", "-1", "+1", " 1", "1 ", "1x", "0x10", "18446744073709551616",
+            "99999999999999999999999" })
+        {
+            EXPECT_FALSE(parseCount(str, count)) << str;
+        }
 
-    class TestB64Ctor64 : public ::testing::TestWithParam<
-        std::tuple<u64, std::string>>
-    {
-    public:
-        static const std::vector<std::tuple<u64, std::string>> tests;
-    };
+        EXPECT_FALSE(parseCount("4294967296", count, UINT32_MAX));
+        EXPECT_FALSE(parseCount(nullptr, count));
+        EXPECT_EQ(count, 7u);
+    }
 
-    const std::vector<std::tuple<u64, std::string>> TestB64Ctor64::tests =
+#ifndef _WIN32
+    /* Sends `input` to the daemon on `path`, closes the sending side and
+       returns the reply lines. */
+    static std::vector<std::string> daemonRoundTrip(const std::string& path, const std::string& input)
     {
-        {                  0, "A" },
-        {                  1, "B" },
-        {                 12, "M" },
-        {              0x37e, "-N" },
-        {             0x3cb2, "yyD" },
-        {            0x572db, "bLXB" },
-        {           0x678ec9, "J74Z" },
-        {          0xe67d28b, "LK9ZO" },
-        {         0x57ce65ab, "rWmzXB" },
-        {         0x89abcdef, "v38qJC" },
-        {         0xffffffff, "_____D" },
-        {        0x8bc41fd99, "Z2fQ8i" },
-        {       0x8b4e3ea1cd, "NHqPOtI" },
-        {      0xfeb832d1a9c, "cqRLDu-D" },
-        {   0x1a2b3c4d5e6fee, "u_mXNxzKa" },
-        { 0xf9e8d7c6b5a43210, "QIDp1a81onP" }
-    };
+        std::vector<std::string> lines;
+        sockaddr_un addr;
 
-    TEST_P(TestB64Ctor64, TestProper)
-    {
-        const std::tuple<u64, std::string>& param = GetParam();
-        const u64 val = std::get<0>(param);
-        const std::string& expected = std::get<1>(param);
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.c_str(), path.size());
 
-        Base64 obj(val);
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
 
-        ASSERT_EQ(expected, obj.toString());
-    }
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+        {
+            close(fd);
+            return lines;
+        }
 
-    INSTANTIATE_TEST_SUITE_P(
-        ParamTest,
-        TestB64Ctor64,
-        ::testing::ValuesIn(TestB64Ctor64::tests));
+        // Small enough not to block before the daemon reads
+        EXPECT_EQ(write(fd, input.c_str(), input.size()), static_cast<ssize_t>(input.size()));
+        shutdown(fd, SHUT_WR);
 
-    TEST(TestB64, Incr)
-    {
-        Base64 obj;
+        std::string received;
+        char buf[4096];
 
-        EXPECT_EQ("A", obj.toString());
+        for (ssize_t n = read(fd, buf, sizeof(buf)); n > 0; n = read(fd, buf, sizeof(buf)))
+            received.append(buf, n);
 
-        obj.incr();
-        EXPECT_EQ("B", obj.toString());
+        close(fd);
 
-        obj.incr();
-        EXPECT_EQ("C", obj.toString());
+        std::stringstream ss(received);
 
-        obj.incr();
-        EXPECT_EQ("D", obj.toString());
+        for (std::string line; std::getline(ss, line);)
+            lines.push_back(line);
 
-        for (u32 i = 0; i < 60; i++)
-            obj.incr();
+        return lines;
+    }
 
-        EXPECT_EQ("_", obj.toString());
+    static std::string daemonTestSocket()
+    {
+        return (std::filesystem::temp_directory_path() /
+            ("wxpowerd-test-" + std::to_string(getpid()) + ".sock")).string();
+    }
 
-        obj.incr();
-        EXPECT_EQ("AB", obj.toString());
+    // Lines which aren't v0 proofs never reach RX
+    TEST(TestVerifyDaemon, Invalid)
+    {
+        VerifyDaemon::Options options;
+        options.socketPath = daemonTestSocket();
 
-        for (u32 i = 0; i < 63; i++)
-            obj.incr();
+        VerifyDaemon daemon(options);
+        std::string error;
+        ASSERT_TRUE(daemon.start(error)) << error;
 
-        EXPECT_EQ("_B", obj.toString());
+        const std::vector<std::string> lines = daemonRoundTrip(
+            options.socketPath, "garbage\n\r\n|wxPoW0||\nHello world!|wxPoW1|a|b");
 
-        obj.incr();
-        EXPECT_EQ("AC", obj.toString());
+        ASSERT_EQ(lines.size(), 4u);
 
+        for (const std::string& line : lines)
+            EXPECT_EQ(line, "{\"status\":\"invalid\"}");
 
-        for (u32 i = 0; i < (62 * 64 - 1); i++)
-            obj.incr();
+        const VerifyDaemon::Stats stats = daemon.getStats();
+        EXPECT_EQ(stats.connections, 1u);
+        EXPECT_EQ(stats.requests, 4u);
+        EXPECT_EQ(stats.shed, 0u);
 
-        EXPECT_EQ("__", obj.toString());
+        // A second server can't take over a live socket
+        VerifyDaemon other(options);
+        EXPECT_FALSE(other.start(error));
 
-        obj.incr();
-        EXPECT_EQ("AAB", obj.toString());
+        daemon.stop();
+        EXPECT_FALSE(std::filesystem::exists(options.socketPath));
     }
 
-    ////////////////////////////////////////////////////////////////////////////
-    ////////////////////////////////////////////////////////////////////////////
-    ////////////////////////////////////////////////////////////////////////////
+    // A real proof gets the same diff and hash as `verifyMessage`
+    TEST(TestVerifyDaemon, Ok)
+    {
+        VerifyDaemon::Options options;
+        options.socketPath = daemonTestSocket();
+
+        VerifyDaemon daemon(options);
+        std::string error;
+        ASSERT_TRUE(daemon.start(error)) << error;
+
+        const std::string proof = "Hello world!|wxPoW0|alice|x";
+        const std::vector<std::string> lines = daemonRoundTrip(options.socketPath, proof + "\n");
+
+        std::optional<HashResult> res;
+        std::string prettyMetaData;
+        PowerV0 power;
+        ASSERT_TRUE(power.verifyMessage(proof, false, res, prettyMetaData, error));
+        ASSERT_TRUE(res.has_value()) << error;
+
+        ASSERT_EQ(lines.size(), 1u);
+        EXPECT_EQ(lines[0], "{\"status\":\"ok\",\"diff\":" + std::to_string(res->diff) +
+            ",\"hash\":\"" + res->hash.toString() + "\",\"userId\":\"alice\",\"context\":\"x\"}");
+        EXPECT_EQ(daemon.getStats().requests, 1u);
+    }
 
-    TEST(TestSha256, SanityChecks)
+    TEST(TestVerifyDaemon, Limits)
     {
-        Sha256 obj;
+        VerifyDaemon::Options options;
+        options.socketPath = daemonTestSocket();
+        options.maxQueued = 0;
+        options.maxLineBytes = 10;
+
+        VerifyDaemon daemon(options);
+        std::string error;
+        ASSERT_TRUE(daemon.start(error)) << error;
+
+        const std::vector<std::string> lines = daemonRoundTrip(
+            options.socketPath, "a|wxPoW0|b\nfar too long a line\nnever read\n");
+
+        ASSERT_EQ(lines.size(), 2u);
+        EXPECT_EQ(lines[0], "{\"status\":\"busy\"}");
+        EXPECT_EQ(lines[1], "{\"status\":\"invalid\",\"error\":\"Line too long.\"}");
+        EXPECT_EQ(daemon.getStats().shed, 1u);
+    }
 
-        std::string toHash = "Hello world!";
-        Bigint ret = obj.doHash(toHash.c_str(), static_cast<u32>(toHash.size()));
+    /* Invalid lines are answered by the I/O thread and shed ones by the
+       queue, but replies still come back in request order. One reply owed
+       at a time makes the daemon stop and resume reading after each line. */
+    TEST(TestVerifyDaemon, Order)
+    {
+        VerifyDaemon::Options options;
+        options.socketPath = daemonTestSocket();
+        options.maxQueued = 0;
+        options.maxPendingReplies = 1;
 
-        ASSERT_STREQ(
-            ret.toString().c_str(),
-            "c0535e4be2b79ffd93291305436bf889314e4a3faec05ecffcbb7df31ad9e51a");
+        VerifyDaemon daemon(options);
+        std::string error;
+        ASSERT_TRUE(daemon.start(error)) << error;
 
-        toHash = "304";
-        ret = obj.doHash(toHash.c_str(), static_cast<u32>(toHash.size()));
+        const std::vector<std::string> lines = daemonRoundTrip(options.socketPath,
+            "garbage\na|wxPoW0|b\n|wxPoW0||\nc|wxPoW0|d\r\nc|wxPoW0|d\nlast");
 
-        ASSERT_STREQ(
-            ret.toString().c_str(),
-            "d874e4e4a5df21173b0f83e313151f813bea4f488686efe670ae47f87c177595");
+        const std::string invalid = "{\"status\":\"invalid\"}";
+        const std::string busy = "{\"status\":\"busy\"}";
+
+        EXPECT_EQ(lines, std::vector<std::string>({ invalid, busy, invalid, busy, busy, invalid }));
+
+        const VerifyDaemon::Stats stats = daemon.getStats();
+        EXPECT_EQ(stats.requests, 6u);
+        EXPECT_EQ(stats.shed, 3u);
     }
+#endif
 
     class Test_PowerV0 : public PowerV0
     {
@@ -360,6 +2037,16 @@ namespace wxpower
             true,
             { "|wxPoW0|    |wxPoW0|    |wxPoW0|Hello world!", 0, "qwerty", "uiop" }
         },
+        {
+            "Hello world!|wxPoW0|qwe\\|rty|ui\\op",
+            true,
+            { "Hello world!", 0, "qwe|rty", "uiop" }
+        },
+        {
+            "Hello world!|wxPoW0|\\\\|qwerty|ui|op",
+            true,
+            { "Hello world!", 0, "|qwerty", "ui|op" }
+        },
     };
 
     TEST_P(Test_PowerV0_msgToContent, TestProper)
@@ -385,6 +2072,99 @@ namespace wxpower
         Test_PowerV0_msgToContent,
         ::testing::ValuesIn(Test_PowerV0_msgToContent::tests));
 
+    static void refTrimBody(std::string& body);
+
+    /* Original copying implementation, kept as the reference. It trims with
+       the reference trim too, so it shares no code with what it checks. */
+    static bool refMsgToContent(PowerV0::ProofContent& proof, const std::string& msgOrig)
+    {
+        std::string msg = msgOrig;
+        PowerV0::ProofContent out;
+
+        refTrimBody(msg);
+
+        const size_t pos = msg.rfind(PowerV0::magicSequence);
+
+        if ((pos == std::string::npos) || (pos == 0) ||
+            ((pos + PowerV0::magicSequence.size()) >= msg.size()))
+            return false;
+
+        out.body = msg.substr(0, pos);
+
+        size_t idx = pos + PowerV0::magicSequence.size();
+        bool justSawBackslash = false;
+
+        for (; idx < msg.size(); idx++)
+        {
+            const char c = msg.at(idx);
+
+            if (c == '\\')
+                justSawBackslash = true;
+            else if ((c == '|') && !justSawBackslash)
+            {
+                idx++;
+                break;
+            }
+            else
+            {
+                out.userId += c;
+                justSawBackslash = false;
+            }
+        }
+
+        for (; idx < msg.size(); idx++)
+            if (msg.at(idx) != '\\')
+                out.context += msg.at(idx);
+
+        proof = out;
+
+        return true;
+    }
+
+    TEST(Test_PowerV0_parseProof, MatchesReference)
+    {
+        const std::vector<std::string> pieces = {
+            "a", "b", "|", "\\", " ", "\n", "|wxPoW0|", "\xe3\x80\x80", "\xc2\xa0"
+        };
+
+        std::mt19937 rng(1234);
+        Test_PowerV0 power;
+
+        for (u32 i = 0; i < 20000; i++)
+        {
+            std::string msg;
+            const u32 count = rng() % 16;
+
+            for (u32 j = 0; j < count; j++)
+                msg += pieces.at(rng() % pieces.size());
+
+            PowerV0::ProofContent expected;
+            PowerV0::ProofContent actual;
+            PowerV0::ProofView view;
+
+            const bool expectedRet = refMsgToContent(expected, msg);
+
+            ASSERT_EQ(PowerV0::parseProof(msg, view), expectedRet) << msg;
+            ASSERT_EQ(power.msgToContent(actual, msg), expectedRet) << msg;
+
+            if (!expectedRet)
+                continue;
+
+            EXPECT_EQ(view.body, expected.body) << msg;
+            EXPECT_EQ(view.userId, expected.userId) << msg;
+            EXPECT_EQ(view.context, expected.context) << msg;
+
+            EXPECT_EQ(actual.body, expected.body) << msg;
+            EXPECT_EQ(actual.userId, expected.userId) << msg;
+            EXPECT_EQ(actual.context, expected.context) << msg;
+
+            EXPECT_EQ(PowerV0::contentToMetaData(view),
+                PowerV0::contentToMetaData(expected)) << msg;
+            EXPECT_EQ(PowerV0::contentToPrettyMetaData(view),
+                PowerV0::contentToPrettyMetaData(expected)) << msg;
+        }
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////
@@ -566,4 +2346,157 @@ namespace wxpower
         ParamTest,
         Test_PowerV0_trimBody,
         ::testing::ValuesIn(Test_PowerV0_trimBody::tests));
+
+    /* The original `utf8CharsToSkip` and `trimBody`, verbatim but for
+       dropping the asserts, as release builds do. Trimming must match them
+       byte for byte, since proofs hash the trimmed body. */
+    static s32 refUtf8CharsToSkip(const std::string& str, s32 pos)
+    {
+        s32 ret = 0;
+        const char c = str.at(pos);
+
+        if ((c & 0x80) == 0)
+        {
+            if (std::binary_search(PowerV0::skippable1.cbegin(), PowerV0::skippable1.cend(), c))
+                ret = 1;
+        }
+        else if ((c == static_cast<char>(0xc2)) && (static_cast<size_t>(pos + 1) <= str.size()))
+        {
+            const std::string substr2 = str.substr(pos, 2);
+
+            if (std::binary_search(PowerV0::skippable2.cbegin(), PowerV0::skippable2.cend(), substr2))
+                ret = 2;
+        }
+        else if (static_cast<size_t>(pos + 2) <= str.size())
+        {
+            const std::string substr3 = str.substr(pos, 3);
+
+            if (std::binary_search(PowerV0::skippable3.cbegin(), PowerV0::skippable3.cend(), substr3))
+                ret = 3;
+        }
+
+        return ret;
+    }
+
+    static void refTrimBody(std::string& body)
+    {
+        const s32 msgLen = static_cast<s32>(body.size());
+        s32 start = 0;
+
+        if (msgLen > 0)
+        {
+            while (start < static_cast<s32>(body.size()))
+            {
+                const s32 skip = refUtf8CharsToSkip(body, start);
+
+                if (skip > 0)
+                    start += skip;
+                else
+                    break;
+            }
+
+            s32 end = static_cast<s32>(body.size() - 1);
+            s32 charBytes = 0;
+
+            while ((end - charBytes) >= start)
+            {
+                const char thisC = body.at(end - charBytes);
+
+                if ((thisC & 0xc0) == 0x80)
+                    charBytes++;
+                else
+                {
+                    if ((end - charBytes) >= 0)
+                    {
+                        const s32 skip = refUtf8CharsToSkip(body, end - charBytes);
+
+                        if (skip > 0)
+                        {
+                            // Found trailing UTF-8 whitespace
+                            end -= skip;
+                            charBytes = 0;
+                        }
+                        else
+                        {
+                            // Reached a non-skippable UTF-8 char
+                            break;
+                        }
+                    }
+                    else
+                    {
+                        // Malformed string?
+                        break;
+                    }
+                }
+            }
+
+            const s32 newLen = end - start + 1;
+
+            if (newLen > 0)
+                body = body.substr(start, newLen);
+            else
+                body.clear();
+        }
+    }
+
+    TEST(Test_PowerV0_utf8CharsToSkip, MatchesTables)
+    {
+        std::string str(3, '\0');
+
+        for (u32 first = 0; first < 256; first++)
+        {
+            str.resize(1);
+            str[0] = static_cast<char>(first);
+
+            EXPECT_EQ(PowerV0::utf8CharsToSkip(str, 0), refUtf8CharsToSkip(str, 0)) << first;
+
+            if (first < 0x80)
+                continue;
+
+            for (u32 rest = 0; rest < 0x10000; rest++)
+            {
+                str.resize(3);
+                str[1] = static_cast<char>(rest >> 8);
+                str[2] = static_cast<char>(rest & 0xff);
+
+                ASSERT_EQ(PowerV0::utf8CharsToSkip(str, 0), refUtf8CharsToSkip(str, 0))
+                    << first << ' ' << rest;
+            }
+        }
+    }
+
+    TEST(Test_PowerV0_trimBody, Fuzz)
+    {
+        const std::vector<std::string> pieces = {
+            "a", "\xc3\xa9", "|", " ", "\t", "\n", "\r", "\x0b", "\x0c",
+            "\xc2\x85", "\xc2\xa0", "\xe3\x80\x80", "\xe2\x80\x8b", "\xe3\xbb\xbf",
+            "\xc2", "\xe3\x80", "\x80", "\xbf"
+        };
+
+        std::mt19937 rng(4321);
+
+        for (u32 i = 0; i < 20000; i++)
+        {
+            std::string body;
+            const u32 count = rng() % 12;
+
+            for (u32 j = 0; j < count; j++)
+            {
+                // Long runs of spaces take the vector path
+                if ((rng() % 4) == 0)
+                    body += std::string(rng() % 40, (rng() % 2) ? ' ' : '\n');
+                else
+                    body += pieces.at(rng() % pieces.size());
+            }
+
+            std::string expected = body;
+            refTrimBody(expected);
+
+            std::string trimmed = body;
+            PowerV0::trimBody(trimmed);
+
+            ASSERT_EQ(trimmed, expected) << body;
+            ASSERT_EQ(PowerV0::trimmedBody(body), trimmed) << body;
+        }
+    }
 }
@@ -0,0 +1,745 @@
+#include <cmath>
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+#include "power.hpp"
+
+#include "configuration.h"
+
+namespace
+{
+    using namespace wxpower;
+
+    // Runs `fn(i)` for every i below `count`, on up to `threadCount` threads
+    template <typename F>
+    void parallelFor(size_t count, u32 threadCount, const F& fn)
+    {
+        std::atomic<size_t> next{0};
+
+        const auto entry = [&]()
+        {
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+                fn(i);
+        };
+
+        const size_t spawned = std::min<size_t>(threadCount, count);
+        std::vector<std::thread> threads;
+
+        for (size_t t = 1; t < spawned; t++)
+            threads.emplace_back(entry);
+
+        entry();
+
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    // Counts live RX caches so a batch with many Ks can't exhaust memory
+    class CacheSlots
+    {
+    public:
+        explicit CacheSlots(u32 max_) : max(max_) {}
+
+        void acquire()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return live < max; });
+            live++;
+        }
+
+        void release()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                live--;
+            }
+
+            cv.notify_one();
+        }
+
+    private:
+        const u32 max;
+        u32 live = 0;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+
+    /* Full mode builds with every core, so only one group in the process
+       does at a time, whichever verifier it belongs to. This also keeps
+       concurrent batches from each allocating a dataset. */
+    std::atomic<bool> datasetBusy{false};
+
+    /* Measured once per process, see `BatchVerifierV0::getCalibration`.
+       Indexed by `useLargePages`, since large pages change every figure. */
+    std::mutex calibrationMutex;
+    std::optional<BatchVerifierV0::Calibration> calibrations[2];
+
+    struct Parsed
+    {
+        // Into the caller's proof, which outlives `verify`
+        std::string_view body;
+        std::string metaData;
+        Bigint K;
+    };
+
+    /* All proofs sharing one K. The first thread to reach the group builds
+       its cache; every thread working on it then takes its own VM. */
+    struct Group
+    {
+        Bigint K;
+        std::vector<size_t> items;
+
+        std::mutex mutex;
+        bool initDone = false;
+        std::unique_ptr<RxManager> rx;
+        std::string error;
+
+        // Hashed with a dataset rather than the cache
+        bool full = false;
+        std::optional<double> datasetBuild;
+        std::atomic<u64> fullHashNanos{0};
+        std::atomic<size_t> fullHashes{0};
+
+        std::atomic<u32> nextVM{0};
+        std::atomic<size_t> remaining{0};
+    };
+}
+
+namespace wxpower
+{
+    BatchVerifierV0::BatchVerifierV0(
+        bool useLargePages_, u32 threadCount_, u32 maxCaches_, bool adaptive_) :
+        useLargePages(useLargePages_),
+        threadCount((threadCount_ > 0) ? threadCount_ :
+            std::max<u32>(std::thread::hardware_concurrency(), 1)),
+        maxCaches(maxCaches_),
+        adaptive(adaptive_)
+    {
+    }
+
+    BatchVerifierV0::Calibration BatchVerifierV0::calibrate(bool useLargePages)
+    {
+        Calibration ret;
+        randomx_flags flags = randomx_get_flags();
+        randomx_cache* cache = nullptr;
+
+        ret.datasetBuild = std::numeric_limits<double>::infinity();
+
+        if (useLargePages)
+            cache = randomx_alloc_cache(flags | RANDOMX_FLAG_LARGE_PAGES);
+
+        if (cache == nullptr)
+            cache = randomx_alloc_cache(flags);
+
+        // Light mode it is, then
+        if (cache == nullptr)
+            return ret;
+
+        // Any K will do
+        const Bigint K;
+        randomx_init_cache(cache, K.getBytes(), 32);
+
+        // Light hashing
+        {
+            const u32 hashes = 8;
+            randomx_vm* const vm = randomx_create_vm(flags, cache, nullptr);
+            Bigint hash;
+            const auto tic = NOW;
+
+            for (u32 i = 0; i < hashes; i++)
+                randomx_calculate_hash(vm, &i, sizeof(i), hash.getBytes());
+
+            ret.lightHash = SECS(NOW - tic) / hashes;
+            randomx_destroy_vm(vm);
+        }
+
+        /* Dataset init: one chunk on one thread, for what an item costs a
+           light hash, then a chunk per hardware thread for the build rate.
+           Only the pages written are touched. */
+        randomx_dataset* const dataset = randomx_alloc_dataset(flags);
+
+        if (dataset != nullptr)
+        {
+            const unsigned long chunkItems = RxDataset::initChunkItems;
+            const u32 initThreads = std::max<u32>(std::thread::hardware_concurrency(), 1);
+
+            auto tic = NOW;
+            randomx_init_dataset(dataset, cache, 0, chunkItems);
+
+            const double item = SECS(NOW - tic) / chunkItems;
+            std::vector<std::thread> threads;
+
+            tic = NOW;
+
+            for (u32 t = 0; t < initThreads; t++)
+            {
+                threads.emplace_back(randomx_init_dataset, dataset, cache,
+                    (t + 1) * chunkItems, chunkItems);
+            }
+
+            for (std::thread& thread : threads)
+                thread.join();
+
+            const double rate = initThreads * chunkItems / SECS(NOW - tic);
+            const double itemsPerHash =
+                static_cast<double>(RANDOMX_PROGRAM_COUNT) * RANDOMX_PROGRAM_ITERATIONS;
+
+            ret.datasetBuild = randomx_dataset_item_count() / rate;
+            ret.fullHash = std::max(ret.lightHash - itemsPerHash * item, 0.0);
+
+            randomx_release_dataset(dataset);
+        }
+
+        randomx_release_cache(cache);
+
+        return ret;
+    }
+
+    BatchVerifierV0::Calibration BatchVerifierV0::getCalibration(bool useLargePages)
+    {
+        std::lock_guard<std::mutex> lock(calibrationMutex);
+        std::optional<Calibration>& calibration = calibrations[useLargePages];
+
+        if (!calibration.has_value())
+            calibration.emplace(calibrate(useLargePages));
+
+        return calibration.value();
+    }
+
+    void BatchVerifierV0::refineCalibration(
+        bool useLargePages, double fullHash, std::optional<double> datasetBuild)
+    {
+        std::lock_guard<std::mutex> lock(calibrationMutex);
+        std::optional<Calibration>& calibration = calibrations[useLargePages];
+
+        if (!calibration.has_value())
+            return;
+
+        calibration->fullHash = fullHash;
+        calibration->fullHashMeasured = true;
+
+        if (datasetBuild.has_value())
+            calibration->datasetBuild = datasetBuild.value();
+    }
+
+    size_t BatchVerifierV0::getBreakEven(
+        const Calibration& calibration, u32 hashThreads)
+    {
+        /* n hashes take n * lightHash / threads in light mode, or
+           datasetBuild + n * fullHash / threads in full mode. */
+        const double saved = calibration.lightHash - calibration.fullHash;
+
+        if (!(saved > 0) || !std::isfinite(calibration.datasetBuild))
+            return SIZE_MAX;
+
+        const double n = std::ceil(calibration.datasetBuild * hashThreads / saved);
+
+        if (n >= static_cast<double>(SIZE_MAX))
+            return SIZE_MAX;
+
+        return static_cast<size_t>(n);
+    }
+
+    std::vector<BatchVerifierV0::Result> BatchVerifierV0::verify(
+        const std::vector<std::string>& proofs)
+    {
+        const std::atomic<bool> cancelled{false};
+        std::atomic<size_t> done{0};
+
+        return verify(proofs, cancelled, done);
+    }
+
+    std::vector<BatchVerifierV0::Result> BatchVerifierV0::verify(
+        const std::vector<std::string>& proofs,
+        const std::atomic<bool>& cancelled, std::atomic<size_t>& done)
+    {
+        return verify(std::vector<std::string_view>(proofs.cbegin(), proofs.cend()),
+            cancelled, done);
+    }
+
+    std::vector<BatchVerifierV0::Result> BatchVerifierV0::verify(
+        const std::vector<std::string_view>& proofs)
+    {
+        const std::atomic<bool> cancelled{false};
+        std::atomic<size_t> done{0};
+
+        return verify(proofs, cancelled, done);
+    }
+
+    std::vector<BatchVerifierV0::Result> BatchVerifierV0::verify(
+        const std::vector<std::string_view>& proofs,
+        const std::atomic<bool>& cancelled, std::atomic<size_t>& done)
+    {
+        std::vector<Result> results(proofs.size());
+        std::vector<Parsed> parsed(proofs.size());
+
+        // Parse and hash the metadata of every proof
+        parallelFor(proofs.size(), threadCount, [&](size_t i)
+        {
+            PowerV0::ProofView view;
+
+            if (!PowerV0::parseProof(proofs.at(i), view))
+            {
+                done++;
+                return;
+            }
+
+            Parsed& p = parsed.at(i);
+            Result& result = results.at(i);
+            Sha256 sha256;
+
+            result.parsed = true;
+            result.prettyMetaData = PowerV0::contentToPrettyMetaData(view);
+
+            result.content.userId = view.userId;
+            result.content.context = view.context;
+
+            p.metaData = PowerV0::contentToMetaData(view);
+            p.K = sha256.doHash(p.metaData.c_str(), static_cast<u32>(p.metaData.size()));
+            p.body = view.body;
+        });
+
+        // Group by K, in order of first appearance
+        std::unordered_map<std::string, size_t> groupOf;
+        std::vector<std::vector<size_t>> groupItems;
+
+        for (size_t i = 0; i < proofs.size(); i++)
+        {
+            if (!results.at(i).parsed)
+                continue;
+
+            const std::string key(
+                reinterpret_cast<const char*>(parsed.at(i).K.getBytes()), 32);
+            const auto inserted = groupOf.emplace(key, groupItems.size());
+
+            if (inserted.second)
+                groupItems.emplace_back();
+
+            groupItems.at(inserted.first->second).push_back(i);
+        }
+
+        lastGroupCount = groupItems.size();
+        lastFullGroupCount = 0;
+
+        if (groupItems.empty())
+            return results;
+
+        // Fixed size from here on; groups can't move
+        std::vector<Group> groups(groupItems.size());
+
+        /* Work in group order, so a group's cache is only needed while its
+           own items are being hashed and can be freed straight after. */
+        std::vector<std::pair<size_t, size_t>> work;
+
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            groups.at(g).items = std::move(groupItems.at(g));
+            groups.at(g).K = parsed.at(groups.at(g).items.front()).K;
+            groups.at(g).remaining.store(groups.at(g).items.size());
+
+            for (size_t i : groups.at(g).items)
+                work.emplace_back(g, i);
+        }
+
+        const u32 hashThreads = static_cast<u32>(
+            std::min<size_t>(threadCount, work.size()));
+        u32 cacheLimit = maxCaches;
+
+        if (cacheLimit == 0)
+        {
+            const u64 cacheBytes = static_cast<u64>(RANDOMX_ARGON_MEMORY) * 1024 +
+                static_cast<u64>(hashThreads) * RANDOMX_SCRATCHPAD_L3;
+            const std::optional<u64> available = getAvailableMemory();
+
+            cacheLimit = hashThreads;
+
+            if (available.has_value())
+            {
+                cacheLimit = static_cast<u32>(std::min<u64>(
+                    cacheLimit, available.value() / 2 / cacheBytes));
+            }
+        }
+
+        // Caches come from the pool, which can't lend more than this
+        const u32 poolCapacity = RxCachePool::instance().getCapacity();
+
+        if (poolCapacity > 0)
+            cacheLimit = std::min(cacheLimit, poolCapacity);
+
+        CacheSlots slots(std::max<u32>(cacheLimit, 1));
+        std::atomic<size_t> nextWork{0};
+
+        // Full mode builds with every core, see `datasetBusy`
+        std::vector<u32> initCores(std::max<u32>(std::thread::hardware_concurrency(), 1));
+        std::atomic<size_t> fullGroups{0};
+
+        std::iota(initCores.begin(), initCores.end(), 0);
+
+        /* If `wantFull` will need the calibration, measure it now while
+           nothing else of this batch is hashing. Done from within, it would
+           hold a group's mutex and cache slot and skew its own timings. */
+        const bool mayWantFull = adaptive && std::any_of(groups.cbegin(), groups.cend(),
+            [&](const Group& group)
+            {
+                return (group.items.size() > hashThreads) &&
+                    !RxDatasetCache::instance().contains(group.K);
+            });
+
+        if (mayWantFull && !cancelled.load())
+            getCalibration(useLargePages);
+
+        // Called for a group's first item, with its mutex held
+        const auto wantFull = [&](const Group& group)
+        {
+            // Each VM hashing once can't beat a build of the whole dataset
+            if (!adaptive || (group.items.size() <= hashThreads))
+                return false;
+
+            if (!RxDatasetCache::instance().contains(group.K) &&
+                (group.items.size() <= getBreakEven(getCalibration(useLargePages), hashThreads)))
+            {
+                return false;
+            }
+
+            return !datasetBusy.exchange(true);
+        };
+
+        const auto hashEntry = [&]()
+        {
+            size_t current = SIZE_MAX;
+            randomx_vm* vm = nullptr;
+
+            for (size_t w = nextWork.fetch_add(1); w < work.size(); w = nextWork.fetch_add(1))
+            {
+                Group& group = groups.at(work.at(w).first);
+                Result& result = results.at(work.at(w).second);
+                const Parsed& p = parsed.at(work.at(w).second);
+
+                if (work.at(w).first != current)
+                {
+                    std::lock_guard<std::mutex> lock(group.mutex);
+
+                    current = work.at(w).first;
+                    vm = nullptr;
+
+                    if (!group.initDone)
+                    {
+                        // No thread touches a group twice, so this many VMs suffice
+                        const u32 vmCount = static_cast<u32>(
+                            std::min<size_t>(hashThreads, group.items.size()));
+
+                        slots.acquire();
+
+                        const bool full = !cancelled.load() && wantFull(group);
+
+                        try
+                        {
+                            if (cancelled.load())
+                                slots.release();
+                            else if (full)
+                            {
+                                // Falls back to light mode if memory is short
+                                group.rx = std::make_unique<RxManager>(
+                                    useLargePages, group.K, initCores,
+                                    std::vector<u32>(vmCount, 0), cancelled, RxMode::automatic);
+                                group.full = !group.rx->lightMode;
+
+                                if (group.full && !cancelled.load() && !group.rx->reusedDataset &&
+                                    !group.rx->loadedSnapshot && !group.rx->resumedItems.has_value())
+                                {
+                                    group.datasetBuild = group.rx->initTime;
+                                }
+                            }
+                            else
+                            {
+                                group.rx = std::make_unique<RxManager>(
+                                    useLargePages, group.K, vmCount);
+                            }
+                        }
+                        catch (RxManager::Exception& e)
+                        {
+                            group.error = e.getWhat();
+                            slots.release();
+                        }
+                        catch (std::exception& e)
+                        {
+                            // E.g. bad_alloc; fail the group, not the process
+                            group.error = e.what();
+                            slots.release();
+                        }
+
+                        if (group.full)
+                            fullGroups++;
+                        else if (full)
+                            datasetBusy.store(false);
+
+                        group.initDone = true;
+                    }
+
+                    // A build cut short by cancellation has no VMs
+                    if (group.rx && !cancelled.load())
+                        vm = group.rx->getVM(group.nextVM.fetch_add(1));
+                }
+
+                if ((vm != nullptr) && !cancelled.load())
+                {
+                    const auto tic = NOW;
+
+                    result.res.emplace();
+                    randomx_calculate_hash(
+                        vm, p.body.data(), p.body.size(), result.res->hash.getBytes());
+
+                    if (group.full)
+                    {
+                        group.fullHashNanos += std::chrono::duration_cast<
+                            std::chrono::nanoseconds>(NOW - tic).count();
+                        group.fullHashes++;
+                    }
+
+                    result.res->proof.reserve(p.body.size() + 1 + p.metaData.size());
+                    result.res->proof.append(p.body).append(1, '|').append(p.metaData);
+                    result.res->diff = PowerV0::calcLZCDiff(result.res->hash);
+                }
+                else if (!group.error.empty())
+                    result.error = group.error;
+                else
+                    result.error = "Verification cancelled.";
+
+                done++;
+
+                if (group.remaining.fetch_sub(1) == 1)
+                {
+                    std::lock_guard<std::mutex> lock(group.mutex);
+
+                    if (group.full)
+                    {
+                        if (group.fullHashes.load() > 0)
+                        {
+                            refineCalibration(useLargePages,
+                                group.fullHashNanos.load() * 1e-9 / group.fullHashes.load(),
+                                group.datasetBuild);
+                        }
+
+                        datasetBusy.store(false);
+                    }
+
+                    if (group.rx)
+                    {
+                        group.rx.reset();
+                        slots.release();
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+
+        for (u32 t = 1; t < hashThreads; t++)
+            threads.emplace_back(hashEntry);
+
+        hashEntry();
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        lastFullGroupCount = fullGroups.load();
+
+        return results;
+    }
+
+    std::string BatchVerifierV0::formatResult(const Result& result)
+    {
+        if (!result.parsed)
+            return "{\"status\":\"invalid\"}";
+
+        if (!result.res.has_value())
+            return "{\"status\":\"error\",\"error\":\"" + jsonEscape(result.error) + "\"}";
+
+        std::stringstream ss;
+
+        ss << "{\"status\":\"ok\",\"diff\":" << result.res->diff
+            << ",\"hash\":\"" << result.res->hash.toString()
+            << "\",\"userId\":\"" << jsonEscape(result.content.userId)
+            << "\",\"context\":\"" << jsonEscape(result.content.context) << "\"}";
+
+        return ss.str();
+    }
+
+    size_t BatchVerifierV0::getLastGroupCount() const
+    {
+        return lastGroupCount;
+    }
+
+    size_t BatchVerifierV0::getLastFullGroupCount() const
+    {
+        return lastFullGroupCount;
+    }
+
+    AsyncVerifierV0::Job::Job(
+        std::vector<std::string>&& proofs_, bool useLargePages_, Callback&& callback_) :
+        proofs(std::move(proofs_)), useLargePages(useLargePages_),
+        callback(std::move(callback_)), future(promise.get_future().share())
+    {}
+
+    void AsyncVerifierV0::Job::cancel()
+    {
+        cancelled.store(true);
+    }
+
+    bool AsyncVerifierV0::Job::isCancelled() const
+    {
+        return cancelled.load();
+    }
+
+    bool AsyncVerifierV0::Job::isStarted() const
+    {
+        return started.load();
+    }
+
+    size_t AsyncVerifierV0::Job::getDone() const
+    {
+        return done.load();
+    }
+
+    size_t AsyncVerifierV0::Job::getTotal() const
+    {
+        return proofs.size();
+    }
+
+    std::shared_future<AsyncVerifierV0::Results> AsyncVerifierV0::Job::getFuture() const
+    {
+        return future;
+    }
+
+    AsyncVerifierV0::AsyncVerifierV0(u32 workerCount, u32 threadsPerJob_) :
+        threadsPerJob(threadsPerJob_)
+    {
+        for (u32 i = 0; i < std::max<u32>(workerCount, 1); i++)
+            workers.emplace_back(&AsyncVerifierV0::workerEntry, this);
+    }
+
+    AsyncVerifierV0::~AsyncVerifierV0()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            stopping = true;
+
+            for (const std::shared_ptr<Job>& job : queue)
+                job->cancel();
+
+            for (const std::shared_ptr<Job>& job : running)
+                job->cancel();
+        }
+
+        queueChanged.notify_all();
+
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    std::shared_ptr<AsyncVerifierV0::Job> AsyncVerifierV0::submit(
+        std::vector<std::string> proofs, bool useLargePages, Callback callback)
+    {
+        const std::shared_ptr<Job> job(
+            new Job(std::move(proofs), useLargePages, std::move(callback)));
+
+        bool rejected = false;
+
+        // Scope
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            rejected = stopping;
+
+            if (!rejected)
+                queue.push_back(job);
+        }
+
+        if (rejected)
+        {
+            // Only parses, as nothing is hashed once cancelled
+            job->cancel();
+            runJob(*job);
+        }
+        else
+            queueChanged.notify_one();
+
+        return job;
+    }
+
+    size_t AsyncVerifierV0::getQueued() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.size();
+    }
+
+    void AsyncVerifierV0::workerEntry()
+    {
+        for (;;)
+        {
+            std::shared_ptr<Job> job;
+
+            // Scope
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                queueChanged.wait(lock, [this]() { return stopping || !queue.empty(); });
+
+                // Queued jobs are still finished (as cancelled) when stopping
+                if (queue.empty())
+                    return;
+
+                job = queue.front();
+                queue.pop_front();
+                running.push_back(job);
+            }
+
+            runJob(*job);
+
+            // Scope
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running.erase(std::find(running.begin(), running.end(), job));
+            }
+        }
+    }
+
+    void AsyncVerifierV0::runJob(Job& job) const
+    {
+        job.started.store(true);
+
+        BatchVerifierV0 batch(job.useLargePages, threadsPerJob);
+        Results results;
+
+        try
+        {
+            results = batch.verify(job.proofs, job.cancelled, job.done);
+        }
+        catch (...)
+        {
+            job.promise.set_exception(std::current_exception());
+            return;
+        }
+
+        job.promise.set_value(results);
+
+        if (job.callback)
+        {
+            /* Escaping the worker would terminate the process, and the
+               results are in the future either way. */
+            try
+            {
+                job.callback(results);
+            }
+            catch (...)
+            {
+            }
+        }
+    }
+}
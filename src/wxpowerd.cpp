@@ -0,0 +1,114 @@
+#include <csignal>
+
+#include <iostream>
+#include <string>
+
+#include <pthread.h>
+
+#include "power.hpp"
+
+namespace
+{
+    void printUsage(const char* argv0)
+    {
+        std::cerr << "Usage: " << argv0 << " [options]\n"
+            << "  --socket PATH      Unix socket to listen on (default /tmp/wxpowerd.sock)\n"
+            << "  --workers N        Batches verified at once (default 1)\n"
+            << "  --threads N        Hashing threads per worker (default: all)\n"
+            << "  --queue N          Proofs queued before new ones are shed (default 4096)\n"
+            << "  --batch N          Proofs a worker takes at once (default 256)\n"
+            << "  --connections N    Clients served at once (default 64)\n"
+            << "  --cache-mib N      RX cache pool budget in MiB (default 512)\n"
+            << "  --large-pages      Use large pages\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace wxpower;
+
+    VerifyDaemon::Options options;
+    u64 cacheMiB = RxCachePool::defaultBudget() >> 20;
+
+    options.socketPath = "/tmp/wxpowerd.sock";
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        u64 count = 0;
+
+        // Small enough not to overflow where it ends up
+        const u64 maxCount = (arg == "--cache-mib") ? (UINT64_MAX >> 20) : UINT32_MAX;
+
+        if (arg == "--large-pages")
+        {
+            options.useLargePages = true;
+            continue;
+        }
+
+        if (arg == "--socket" && value)
+            options.socketPath = value;
+        else if (!parseCount(value, count, maxCount))
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        else if (arg == "--workers")
+            options.workerCount = static_cast<u32>(count);
+        else if (arg == "--threads")
+            options.threadsPerWorker = static_cast<u32>(count);
+        else if (arg == "--queue")
+            options.maxQueued = count;
+        else if (arg == "--batch")
+            options.maxBatch = count;
+        else if (arg == "--connections")
+            options.maxConnections = count;
+        else if (arg == "--cache-mib")
+            cacheMiB = count;
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        i++;
+    }
+
+    RxCachePool::instance().setBudget(cacheMiB << 20);
+
+    /* Signals are taken by `sigwait` below. Blocked before any thread
+       starts, so that none of them gets one. */
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    std::signal(SIGPIPE, SIG_IGN);
+
+    VerifyDaemon daemon(options);
+    std::string error;
+
+    if (!daemon.start(error))
+    {
+        std::cerr << "wxpowerd: " << error << "\n";
+        return 1;
+    }
+
+    std::cerr << "wxpowerd: listening on " << options.socketPath << "\n";
+
+    int sig = 0;
+    sigwait(&signals, &sig);
+
+    daemon.stop();
+
+    const VerifyDaemon::Stats stats = daemon.getStats();
+    const RxCachePool::Stats cacheStats = RxCachePool::instance().getStats();
+
+    std::cerr << "wxpowerd: stopped; " << stats.connections << " connections, "
+        << stats.requests << " requests, " << stats.verified << " verified, "
+        << stats.shed << " shed, cache hit rate " << cacheStats.getHitRate() << "\n";
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <csignal>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "power.hpp"
+
+namespace
+{
+    volatile std::sig_atomic_t interrupted = 0;
+
+    void onInterrupt(int)
+    {
+        interrupted = 1;
+    }
+
+    void printUsage(const char* argv0)
+    {
+        std::cerr << "Usage: " << argv0 << " [options]\n"
+            << "Measures RX dataset init and hash rate scaling with core count.\n"
+            << "  --cores LIST       Cores to use, in order, e.g. 0-7 (default: all)\n"
+            << "  --steps LIST       Core counts to measure, e.g. 1,2,4,8\n"
+            << "                     (default: 1, 2, 4... and all cores)\n"
+            << "  --pages MODE       normal, large or both (default both)\n"
+            << "  --init-chunks N    Dataset init chunks timed per core (default 32)\n"
+            << "  --hash-seconds N   Hashing time per step (default 2)\n"
+            << "  --json             Print the report as JSON\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace wxpower;
+
+    RxScalingBenchmark::Options options;
+    bool json = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        u64 count = 0;
+
+        if (arg == "--json")
+        {
+            json = true;
+            continue;
+        }
+
+        if (value == nullptr)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        if ((arg == "--cores") || (arg == "--steps"))
+        {
+            const std::optional<std::vector<u32>> list = NumaTopology::parseCpuList(value);
+
+            if (!list.has_value())
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+
+            (arg == "--cores" ? options.cores : options.coreCounts) = list.value();
+        }
+        else if (arg == "--pages")
+        {
+            const std::string mode = value;
+
+            if ((mode != "normal") && (mode != "large") && (mode != "both"))
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+
+            options.withoutLargePages = (mode != "large");
+            options.withLargePages = (mode != "normal");
+        }
+        else if (!parseCount(value, count, UINT32_MAX))
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        else if (arg == "--init-chunks")
+            options.initChunksPerCore = static_cast<u32>(count);
+        else if (arg == "--hash-seconds")
+            options.hashSeconds = static_cast<double>(count);
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        i++;
+    }
+
+    // Ctrl-C stops early, still printing what was measured
+    std::signal(SIGINT, onInterrupt);
+
+    RxScalingBenchmark benchmark(options);
+    std::string lastStatus;
+
+    while (!benchmark.isFinished())
+    {
+        if (interrupted)
+            benchmark.cancel();
+
+        const std::string status = benchmark.getStatus();
+
+        if (status != lastStatus)
+        {
+            std::cerr << "wxpowerscale: " << status << "\n";
+            lastStatus = status;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    const RxScalingBenchmark::Report report = benchmark.getReport();
+
+    if (json)
+        std::cout << RxScalingBenchmark::formatJson(report) << "\n";
+    else
+        std::cout << RxScalingBenchmark::formatText(report);
+
+    return interrupted ? 1 : 0;
+}
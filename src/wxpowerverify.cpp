@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "power.hpp"
+
+namespace
+{
+    void printUsage(const char* argv0)
+    {
+        std::cerr << "Usage: " << argv0 << " [options] [FILE]\n"
+            << "Verifies one proof per line of FILE (default stdin), writing one JSON\n"
+            << "line per proof to stdout, in input order.\n"
+            << "  --unescape         Turn \\n, \\r and \\\\ in lines into a newline, a\n"
+            << "                     carriage return and a backslash first\n"
+            << "  --chunk N          Proofs per batch (default 16384)\n"
+            << "  --jobs N           Batches in flight (default 2)\n"
+            << "  --threads N        Hashing threads per batch (default: all, split\n"
+            << "                     over the jobs)\n"
+            << "  --cache-mib N      RX cache pool budget in MiB (default 512)\n"
+            << "  --large-pages      Use large pages\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace wxpower;
+
+    std::string path;
+    bool unescape = false;
+    bool useLargePages = false;
+    u64 chunk = 16384;
+    u64 jobs = 2;
+    u64 threads = 0;
+    u64 cacheMiB = RxCachePool::defaultBudget() >> 20;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        u64 count = 0;
+
+        // Small enough not to overflow where it ends up
+        const u64 maxCount = (arg == "--cache-mib") ? (UINT64_MAX >> 20) : UINT32_MAX;
+
+        if (arg == "--unescape")
+        {
+            unescape = true;
+            continue;
+        }
+
+        if (arg == "--large-pages")
+        {
+            useLargePages = true;
+            continue;
+        }
+
+        if ((arg.size() > 0) && (arg[0] != '-') && path.empty())
+        {
+            path = arg;
+            continue;
+        }
+
+        if (!parseCount(value, count, maxCount))
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        else if (arg == "--chunk")
+            chunk = std::max<u64>(count, 1);
+        else if (arg == "--jobs")
+            jobs = std::max<u64>(count, 1);
+        else if (arg == "--threads")
+            threads = count;
+        else if (arg == "--cache-mib")
+            cacheMiB = count;
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        i++;
+    }
+
+    std::ifstream file;
+
+    if (!path.empty())
+    {
+        file.open(path, std::ios::binary);
+
+        if (!file)
+        {
+            std::cerr << "wxpowerverify: can't open \"" << path << "\"\n";
+            return 1;
+        }
+    }
+
+    std::istream& in = path.empty() ? std::cin : file;
+
+    // Jobs hash at the same time, so share the cores out between them
+    if (threads == 0)
+        threads = std::max<u64>(std::max<u32>(std::thread::hardware_concurrency(), 1) / jobs, 1);
+
+    std::ios::sync_with_stdio(false);
+    RxCachePool::instance().setBudget(cacheMiB << 20);
+
+    /* Each chunk is grouped by K on its own, so one K never takes more
+       than a chunk's worth of memory; caches stay warm across chunks in
+       the pool. While the oldest job is written out, the next ones hash,
+       so the cores stay busy and at most `jobs` chunks are held. */
+    AsyncVerifierV0 verifier(static_cast<u32>(jobs), static_cast<u32>(threads));
+    std::deque<std::shared_ptr<AsyncVerifierV0::Job>> inFlight;
+
+    u64 total = 0;
+    u64 ok = 0;
+    u64 invalid = 0;
+    u64 failed = 0;
+
+    const auto writeOldest = [&]()
+    {
+        for (const BatchVerifierV0::Result& result : inFlight.front()->getFuture().get())
+        {
+            std::cout << BatchVerifierV0::formatResult(result) << '\n';
+
+            if (!result.parsed)
+                invalid++;
+            else if (result.res.has_value())
+                ok++;
+            else
+                failed++;
+        }
+
+        inFlight.pop_front();
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::string line;
+    bool eof = false;
+
+    while (!eof)
+    {
+        std::vector<std::string> proofs;
+        proofs.reserve(chunk);
+
+        while (proofs.size() < chunk)
+        {
+            if (!std::getline(in, line))
+            {
+                eof = true;
+                break;
+            }
+
+            if (!line.empty() && (line.back() == '\r'))
+                line.pop_back();
+
+            proofs.push_back(unescape ? unescapeLine(line) : line);
+        }
+
+        if (proofs.empty())
+            break;
+
+        total += proofs.size();
+
+        if (inFlight.size() >= jobs)
+            writeOldest();
+
+        inFlight.push_back(verifier.submit(std::move(proofs), useLargePages));
+    }
+
+    while (!inFlight.empty())
+        writeOldest();
+
+    std::cout.flush();
+
+    if (in.bad() || !std::cout)
+    {
+        std::cerr << "wxpowerverify: I/O error\n";
+        return 1;
+    }
+
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cerr << "wxpowerverify: " << total << " proofs, " << ok << " ok, "
+        << invalid << " invalid, " << failed << " failed; "
+        << static_cast<u64>(total / std::max(seconds, 1e-9)) << " proofs/s, cache hit rate "
+        << RxCachePool::instance().getStats().getHitRate() << "\n";
+
+    return 0;
+}
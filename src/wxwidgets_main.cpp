@@ -1,14 +1,17 @@
 #include <cstdio>
 #include <cinttypes>
+#include <cstring>
 
 #include <sstream>
-#include <stack>
 #include <thread>
 
 #include "wx/wx.h"
 #include "wx/cmdline.h"
+#include "wx/filename.h"
+#include "wx/gauge.h"
 #include "wx/notebook.h"
 #include "wx/spinctrl.h"
+#include "wx/stdpaths.h"
 
 #include "power.hpp"
 
@@ -34,6 +37,10 @@ namespace wxpower
         void OnTimer(wxTimerEvent& event);
 
         void BeginProveV0();
+        void ApplyDatasetSettings();
+        void UpdatePrewarm();
+        void UpdateVerify();
+        void UpdateBenchmark();
         void DumpProveV0Info(
             std::stringstream& ss, const ProveV0Manager* state,
             const ProveV0Manager::MasterGuarded& masterGuarded,
@@ -47,6 +54,25 @@ namespace wxpower
         ProveV0Manager* proveV0Mgr = nullptr;
         ProveV0Manager::State proveV0LastState = ProveV0Manager::State::finished;
 
+        /* Dataset for the metadata typed so far, built while the body is
+           being written. Metadata must be unchanged for a while first. */
+        std::unique_ptr<RxPrewarm> prewarm;
+        std::string prewarmMetaData;
+        NowTime prewarmMetaDataTime = NOW;
+
+        // Set when the user cancels proving; cleared once the metadata changes
+        bool prewarmHeld = false;
+
+        // Prove was pressed; waiting for a cancelled pre-warm to stop
+        bool proveV0Pending = false;
+
+        // Verification runs off the GUI thread; one job at a time
+        AsyncVerifierV0 verifier;
+        std::shared_ptr<AsyncVerifierV0::Job> verifyJob;
+        NowTime verifyStart = NOW;
+
+        std::unique_ptr<RxScalingBenchmark> benchmark;
+
         wxTimer updateTimer;
 
         wxMenu* fileMenu = nullptr;
@@ -84,6 +110,7 @@ namespace wxpower
 
         wxTextCtrl* verifyInput = nullptr;
         wxButton* verifySubmit = nullptr;
+        wxGauge* verifyProgress = nullptr;
         wxTextCtrl* verifyOutput = nullptr;
 
         // Settings
@@ -95,7 +122,18 @@ namespace wxpower
         wxCheckListBox* settingsInitCores = nullptr;
         wxCheckListBox* settingsHashCores = nullptr;
         wxCheckBox* settingsLargePages = nullptr;
+        wxCheckBox* settingsCheckpoints = nullptr;
+        wxCheckBox* settingsDeleteCheckpoints = nullptr;
+        wxCheckBox* settingsNumaReplicas = nullptr;
+        wxCheckBox* settingsPrewarm = nullptr;
+        wxStaticText* settingsRxModeLabel = nullptr;
+        wxChoice* settingsRxMode = nullptr;
+        wxStaticText* settingsDatasetCacheLabel = nullptr;
+        wxSpinCtrl* settingsDatasetCache = nullptr;
+        wxStaticText* settingsDatasetSnapshotsLabel = nullptr;
+        wxSpinCtrl* settingsDatasetSnapshots = nullptr;
         wxButton* settingsBenchmark = nullptr;
+        wxTextCtrl* settingsBenchmarkOutput = nullptr;
     };
 
     BEGIN_EVENT_TABLE(wxPowerFrame, wxFrame)
@@ -229,6 +267,9 @@ namespace wxpower
 
         verifySubmit = new wxButton(verifyPanel, wxID_ANY, wxT("Verify"));
 
+        // Pulses while verifying; a single proof has no finer progress
+        verifyProgress = new wxGauge(verifyPanel, wxID_ANY, 100);
+
         verifyOutput = new wxTextCtrl(
             verifyPanel, wxID_ANY, wxEmptyString, wxDefaultPosition,
             wxDefaultSize, wxTE_MULTILINE);
@@ -236,6 +277,7 @@ namespace wxpower
 
         verifySizerLeft->Add(verifyInput, 1, wxEXPAND);
         verifySizerLeft->Add(verifySubmit, 0, wxEXPAND);
+        verifySizerLeft->Add(verifyProgress, 0, wxEXPAND);
 
         verifySizer->Add(verifySizerLeft, 1, wxEXPAND);
         verifySizer->Add(verifyOutput, 1, wxEXPAND);
@@ -286,7 +328,111 @@ namespace wxpower
             settingsPanel, wxID_ANY, wxT("Use large pages"));
         settingsLargePages->SetValue(true);
 
+        settingsCheckpoints = new wxCheckBox(
+            settingsPanel, wxID_ANY, wxT("Save progress checkpoints"));
+        settingsCheckpoints->SetValue(false);
+        settingsCheckpoints->SetToolTip(wxT(
+            "Periodically save proving progress, so proving identical "
+            "content again after a cancel, a crash or a finished proof "
+            "resumes where it left off. The file holds the message in plain "
+            "text"));
+
+        settingsDeleteCheckpoints = new wxCheckBox(
+            settingsPanel, wxID_ANY, wxT("Delete checkpoints of finished proofs"));
+        settingsDeleteCheckpoints->SetValue(false);
+        settingsDeleteCheckpoints->SetToolTip(wxT(
+            "Discard the saved progress once a proof finishes, so the message "
+            "isn't left on disk. Proving it again then starts from scratch. "
+            "Cancelled proofs keep their checkpoint"));
+
+        settingsNumaReplicas = new wxCheckBox(
+            settingsPanel, wxID_ANY, wxT("Dataset copy per NUMA node"));
+        settingsNumaReplicas->SetValue(false);
+        settingsNumaReplicas->SetToolTip(wxT(
+            "On multi-socket machines, give each socket's hash threads their "
+            "own copy of the RX dataset in local memory (about 2 GiB extra "
+            "per socket, other than the one already holding it, where free "
+            "memory allows)"));
+
+        settingsPrewarm = new wxCheckBox(
+            settingsPanel, wxID_ANY, wxT("Prepare dataset while typing"));
+        settingsPrewarm->SetValue(false);
+        settingsPrewarm->SetToolTip(wxT(
+            "Start initializing RX with the init cores once the user ID and "
+            "context have stopped changing, so that proving can start "
+            "hashing sooner. Needs at least one dataset kept between proves"));
+
+        settingsRxModeLabel = new wxStaticText(
+            settingsPanel, wxID_ANY, wxT("RX mode for proving"));
+
+        // Same order as `RxMode`
+        const wxString rxModes[] = {
+            wxT("Full (2 GiB dataset)"),
+            wxT("Light (256 MiB cache, slower)"),
+            wxT("Automatic"),
+            wxT("Hybrid (light until the dataset is built)") };
+
+        settingsRxMode = new wxChoice(
+            settingsPanel, wxID_ANY, wxDefaultPosition, wxDefaultSize,
+            WXSIZEOF(rxModes), rxModes);
+        settingsRxMode->SetSelection(static_cast<int>(RxMode::automatic));
+        settingsRxMode->SetToolTip(wxT(
+            "Automatic uses the full dataset when there is enough free memory "
+            "for it, and light mode otherwise. Hybrid starts hashing right "
+            "away in light mode and switches to full mode once the dataset "
+            "is built"));
+
+        settingsDatasetCacheLabel = new wxStaticText(
+            settingsPanel, wxID_ANY, wxT("Datasets kept between proves"));
+
+        settingsDatasetCache = new wxSpinCtrl(
+            settingsPanel, wxID_ANY, wxT("1"), wxDefaultPosition,
+            wxDefaultSize, wxSP_ARROW_KEYS | wxALIGN_RIGHT);
+        settingsDatasetCache->SetRange(0, 16);
+        settingsDatasetCache->SetToolTip(wxT(
+            "Finished RX datasets (about 2 GiB each) kept in memory, so that "
+            "proving again with the same user ID and context starts hashing "
+            "immediately"));
+
+        settingsDatasetSnapshotsLabel = new wxStaticText(
+            settingsPanel, wxID_ANY, wxT("Dataset snapshots kept on disk"));
+
+        settingsDatasetSnapshots = new wxSpinCtrl(
+            settingsPanel, wxID_ANY, wxT("0"), wxDefaultPosition,
+            wxDefaultSize, wxSP_ARROW_KEYS | wxALIGN_RIGHT);
+        settingsDatasetSnapshots->SetRange(0, 16);
+        settingsDatasetSnapshots->SetToolTip(wxT(
+            "Finished RX datasets (about 2 GiB each) saved to disk, so that "
+            "proving with the same user ID and context after a restart "
+            "loads the dataset instead of initializing it"));
+
+        settingsBenchmark = new wxButton(
+            settingsPanel, wxID_ANY, wxT("Benchmark scaling"));
+        settingsBenchmark->SetToolTip(wxT(
+            "Measure dataset init time and hash rate as the checked hash "
+            "cores are added one power of two at a time, with normal pages "
+            "and (if enabled) large pages. Takes a few minutes and about "
+            "2 GiB of memory"));
+
+        settingsBenchmarkOutput = new wxTextCtrl(
+            settingsPanel, wxID_ANY, wxEmptyString, wxDefaultPosition,
+            wxDefaultSize, wxTE_MULTILINE | wxHSCROLL);
+        settingsBenchmarkOutput->SetEditable(false);
+        settingsBenchmarkOutput->SetFont(wxFont(wxFontInfo().Family(wxFONTFAMILY_TELETYPE)));
+
         settingsSizerOther->Add(settingsLargePages);
+        settingsSizerOther->Add(settingsCheckpoints);
+        settingsSizerOther->Add(settingsDeleteCheckpoints);
+        settingsSizerOther->Add(settingsNumaReplicas);
+        settingsSizerOther->Add(settingsPrewarm);
+        settingsSizerOther->Add(settingsRxModeLabel);
+        settingsSizerOther->Add(settingsRxMode);
+        settingsSizerOther->Add(settingsDatasetCacheLabel);
+        settingsSizerOther->Add(settingsDatasetCache);
+        settingsSizerOther->Add(settingsDatasetSnapshotsLabel);
+        settingsSizerOther->Add(settingsDatasetSnapshots);
+        settingsSizerOther->Add(settingsBenchmark);
+        settingsSizerOther->Add(settingsBenchmarkOutput, 1, wxEXPAND);
 
         settingsSizer->Add(settingsInitCores, 0, wxEXPAND);
         settingsSizer->Add(settingsHashCores, 0, wxEXPAND);
@@ -310,15 +456,37 @@ namespace wxpower
     {
         if (event.GetEventObject() == proveV0Prove)
         {
-            if ((proveV0LastState == ProveV0Manager::State::rxFailed) ||
+            if (proveV0Pending)
+            {
+                // Cancelled before it got going
+                proveV0Pending = false;
+                prewarmHeld = true;
+                EnableProveElements();
+            }
+            else if ((proveV0LastState == ProveV0Manager::State::rxFailed) ||
                 (proveV0LastState == ProveV0Manager::State::rxCancelled) ||
                 (proveV0LastState == ProveV0Manager::State::hashCancelled) ||
                 (proveV0LastState == ProveV0Manager::State::finished))
             {
                 assert(!proveV0Mgr);
 
-                BeginProveV0();
                 DisableProveElements();
+
+                /* The job will pick up whatever the pre-warm built, but it
+                   has to let go of the init cores first. */
+                if (prewarm && !prewarm->isFinished())
+                {
+                    prewarm->cancel();
+                    proveV0Pending = true;
+
+                    proveV0Prove->SetLabel(wxT("Cancel"));
+                    proveV0Prove->Enable();
+                }
+                else
+                {
+                    prewarm.reset();
+                    BeginProveV0();
+                }
             }
             else
             {
@@ -329,74 +497,72 @@ namespace wxpower
                 proveV0Prove->SetLabel(wxT("Cancelling..."));
                 proveV0Prove->Disable();
                 proveV0Mgr->cancel();
+
+                // The user wants the cores back, not another dataset build
+                prewarmHeld = true;
             }
         }
-        else if (event.GetEventObject() == verifySubmit)
+        else if (event.GetEventObject() == settingsBenchmark)
         {
-            const std::string proof = verifyInput->GetValue().utf8_string();
-            std::optional<HashResult> res;
-            std::string error;
-            std::stack<u32> versions;
-            bool foundVersion = false;
-            std::stringstream ss;
-
-            ss << "\n----------------------------------------";
-            ss << "\nNew verification.\n\nTrying proof spec versions:";
-
-            for (u32 i = 0; i <= PowerBase::latestVersion; i++)
+            if (benchmark)
             {
-                versions.push(i);
+                settingsBenchmark->SetLabel(wxT("Cancelling..."));
+                settingsBenchmark->Disable();
+                benchmark->cancel();
+            }
+            else if (proveV0Mgr || proveV0Pending)
+            {
+                // They would only slow each other down
+                settingsBenchmarkOutput->SetValue(wxT("Stop proving before benchmarking."));
+            }
+            else
+            {
+                RxScalingBenchmark::Options options;
 
-                if (i > 0)
-                    ss << ",";
+                for (unsigned int i = 0; i < settingsHashCores->GetCount(); i++)
+                    if (settingsHashCores->IsChecked(i))
+                        options.cores.push_back(i);
 
-                ss << " " << i;
-            }
+                options.withLargePages = settingsLargePages->GetValue();
 
-            ss << "...\n";
+                // The pre-warm's dataset build would skew the init numbers
+                prewarm.reset();
 
-            while ((versions.size() > 0) && (!foundVersion))
+                benchmark = std::make_unique<RxScalingBenchmark>(options);
+                settingsBenchmark->SetLabel(wxT("Cancel benchmark"));
+                proveV0Prove->Disable();
+            }
+        }
+        else if (event.GetEventObject() == verifySubmit)
+        {
+            if (verifyJob)
             {
-                const u32 thisVersion = versions.top();
-                versions.pop();
+                verifySubmit->SetLabel(wxT("Cancelling..."));
+                verifySubmit->Disable();
+                verifyJob->cancel();
+            }
+            else
+            {
+                const std::string proof = verifyInput->GetValue().utf8_string();
+                std::stringstream ss;
 
-                PowerBase* thisPower = PowerBase::createInstance(thisVersion);
+                ss << "\n----------------------------------------";
+                ss << "\nNew verification.\n";
 
-                if (thisPower)
-                {
-                    std::string prettyMetaData;
-                    const auto tic = NOW;
-
-                    if (thisPower->verifyMessage(
-                        proof, settingsLargePages->GetValue(), res, prettyMetaData, error))
-                    {
-                        const auto toc = NOW;
-                        foundVersion = true;
-                        ss << "\nThis proof uses version " << thisVersion
-                            << ".";
-
-                        if (res.has_value())
-                        {
-                            ss << "\n\n" << prettyMetaData
-                                << "\n\nHash: " << res->hash.toString()
-                                << " (diff: " << res->diff << ")";
-                        }
-                        else
-                        {
-                            ss << "\nError while verifying: " << error;
-                        }
-
-                        ss << "\n\nVerifying took " << SECS(toc - tic) << " seconds.";
-                    }
-
-                    delete thisPower;
-                }
-            }
+                verifyOutput->AppendText(wxString::FromUTF8(ss.str()));
 
-            if (!foundVersion)
-                ss << "\nUnable to identify proof spec version.";
+                /* Only v0 proofs are tried, off the GUI thread. A new version
+                   needs its own job here, and `UpdateVerify` to report it. */
+                static_assert(PowerBase::latestVersion == 0,
+                    "Verify button only handles v0 proofs");
 
-            verifyOutput->AppendText(wxString::FromUTF8(ss.str()));
+                // The rest of the output comes from `UpdateVerify`
+                verifyJob = verifier.submit({ proof }, settingsLargePages->GetValue());
+                verifyStart = NOW;
+
+                verifySubmit->SetLabel(wxT("Cancel"));
+                verifyProgress->Pulse();
+            }
         }
         else
         {
@@ -406,6 +572,78 @@ namespace wxpower
         }
     }
 
+    void wxPowerFrame::UpdateVerify()
+    {
+        const std::shared_future<AsyncVerifierV0::Results> future = verifyJob->getFuture();
+
+        if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            verifyProgress->Pulse();
+            return;
+        }
+
+        std::stringstream ss;
+
+        try
+        {
+            const BatchVerifierV0::Result& result = future.get().at(0);
+
+            if (result.parsed)
+            {
+                ss << "\nThis proof uses version 0.";
+
+                if (result.res.has_value())
+                {
+                    ss << "\n\n" << result.prettyMetaData
+                        << "\n\nHash: " << result.res->hash.toString()
+                        << " (diff: " << result.res->diff << ")";
+                }
+                else
+                {
+                    ss << "\nError while verifying: " << result.error;
+                }
+
+                ss << "\n\nVerifying took " << SECS(NOW - verifyStart) << " seconds.";
+            }
+            else
+                ss << "\nUnable to identify proof spec version.";
+        }
+        catch (const std::exception& e)
+        {
+            ss << "\nError while verifying: " << e.what();
+        }
+
+        verifyOutput->AppendText(wxString::FromUTF8(ss.str()));
+
+        verifyJob.reset();
+        verifyProgress->SetValue(0);
+        verifySubmit->SetLabel(wxT("Verify"));
+        verifySubmit->Enable();
+    }
+
+    void wxPowerFrame::UpdateBenchmark()
+    {
+        if (!benchmark->isFinished())
+        {
+            const wxString status = wxString::FromUTF8(benchmark->getStatus() + "...");
+
+            if (settingsBenchmarkOutput->GetValue() != status)
+                settingsBenchmarkOutput->SetValue(status);
+
+            return;
+        }
+
+        const std::string report = RxScalingBenchmark::formatText(benchmark->getReport());
+
+        settingsBenchmarkOutput->SetValue(wxString::FromUTF8(
+            benchmark->getStatus() + ".\n\n" + report));
+
+        benchmark.reset();
+        settingsBenchmark->SetLabel(wxT("Benchmark scaling"));
+        settingsBenchmark->Enable();
+        proveV0Prove->Enable();
+    }
+
     void wxPowerFrame::BeginProveV0()
     {
         std::stringstream ss;
@@ -477,11 +715,112 @@ namespace wxpower
         if (proveV0UseTimeLimit->GetValue())
             timeLimit.emplace(static_cast<double>(proveV0TimeLimit->GetValue()));
 
+        ProveV0Options options;
+        options.rxMode = static_cast<RxMode>(settingsRxMode->GetSelection());
+        options.numaReplicas = settingsNumaReplicas->GetValue();
+        options.deleteCheckpointOnFinish = settingsDeleteCheckpoints->GetValue();
+
+        if (settingsCheckpoints->GetValue())
+        {
+            const wxString dir = wxStandardPaths::Get().GetUserDataDir() +
+                wxFileName::GetPathSeparator() + wxT("checkpoints");
+
+            if (wxFileName::Mkdir(dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+            {
+                options.checkpointPath = (dir + wxFileName::GetPathSeparator()).utf8_string() +
+                    ProveV0Checkpoint::fileNameFor(content);
+
+                ss << "Checkpoint file: " << options.checkpointPath << "\n";
+            }
+            else
+                ss << "Unable to create checkpoint directory; not saving progress.\n";
+        }
+
         proveV0Output->AppendText(wxString::FromUTF8(ss.str()));
 
+        ApplyDatasetSettings();
+
         proveV0Mgr = new ProveV0Manager(
             content, initCores, hashCores,
-            settingsLargePages->GetValue(), diff, timeLimit);
+            settingsLargePages->GetValue(), diff, timeLimit, options);
+    }
+
+    void wxPowerFrame::ApplyDatasetSettings()
+    {
+        std::string snapshotDir;
+
+        if (settingsDatasetSnapshots->GetValue() > 0)
+            snapshotDir = (wxStandardPaths::Get().GetUserDataDir() +
+                wxFileName::GetPathSeparator() + wxT("datasets")).utf8_string();
+
+        RxDatasetCache::instance().setBudget(
+            static_cast<u64>(settingsDatasetCache->GetValue()) * RxDataset::getBytes());
+        RxDatasetCache::instance().setSnapshotDir(snapshotDir,
+            static_cast<u64>(settingsDatasetSnapshots->GetValue()) * RxDatasetCache::getSnapshotBytes());
+    }
+
+    void wxPowerFrame::UpdatePrewarm()
+    {
+        // Same trimming as `BeginProveV0`, without touching the fields
+        std::string userId = proveV0UserId->GetValue().utf8_string();
+        PowerV0::trimBody(userId);
+
+        std::string context = proveV0Context->GetValue().utf8_string();
+        PowerV0::trimBody(context);
+
+        const std::string metaData = PowerV0::contentToMetaData(
+            PowerV0::ProofContent { std::string(), 0, userId, context });
+
+        if (metaData != prewarmMetaData)
+        {
+            prewarmMetaData = metaData;
+            prewarmMetaDataTime = NOW;
+            prewarmHeld = false;
+        }
+
+        Sha256 sha256;
+        const Bigint K = sha256.doHash(metaData.c_str(), static_cast<u32>(metaData.size()));
+        const bool sameK = prewarm && (memcmp(prewarm->K.getBytes(), K.getBytes(), 32) == 0);
+
+        if (prewarm && !sameK)
+            prewarm->cancel();
+
+        // Drop a stopped pre-warm once its thread is done, without blocking here
+        if (prewarm && prewarm->isCancelled() && prewarm->isFinished())
+            prewarm.reset();
+
+        const RxMode mode = static_cast<RxMode>(settingsRxMode->GetSelection());
+
+        if (prewarm || prewarmHeld || !settingsPrewarm->GetValue() || (mode == RxMode::light) ||
+            (settingsDatasetCache->GetValue() == 0) ||
+            (userId.empty() && context.empty()) ||
+            (SECS(NOW - prewarmMetaDataTime) < 2.0))
+            return;
+
+        std::vector<u32> initCores;
+        wxArrayInt wxInitCores;
+        settingsInitCores->GetCheckedItems(wxInitCores);
+
+        for (size_t i = 0; i < wxInitCores.GetCount(); i++)
+            initCores.push_back(wxInitCores.Item(i));
+
+        if (initCores.empty())
+            return;
+
+        wxArrayInt wxHashCores;
+        settingsHashCores->GetCheckedItems(wxHashCores);
+
+        /* The job would prove in light mode, so the cache init would be
+           wasted and the dataset never used. */
+        if ((mode != RxMode::full) && !RxManager::hasRoomForDataset(
+            ((mode == RxMode::hybrid) ? 2 : 1) * static_cast<u64>(wxHashCores.GetCount())))
+            return;
+
+        ApplyDatasetSettings();
+
+        // Hybrid mode builds the same dataset, just later
+        prewarm = std::make_unique<RxPrewarm>(settingsLargePages->GetValue(), K, initCores,
+            (mode == RxMode::automatic) ? RxMode::automatic : RxMode::full);
     }
 
     void wxPowerFrame::EnableProveElements()
@@ -499,6 +838,12 @@ namespace wxpower
         settingsInitCores->Enable();
         settingsHashCores->Enable();
         settingsLargePages->Enable();
+        settingsCheckpoints->Enable();
+        settingsDeleteCheckpoints->Enable();
+        settingsRxMode->Enable();
+        settingsNumaReplicas->Enable();
+        settingsDatasetCache->Enable();
+        settingsDatasetSnapshots->Enable();
     }
 
     void wxPowerFrame::DisableProveElements()
@@ -515,6 +860,12 @@ namespace wxpower
         settingsInitCores->Disable();
         settingsHashCores->Disable();
         settingsLargePages->Disable();
+        settingsCheckpoints->Disable();
+        settingsDeleteCheckpoints->Disable();
+        settingsRxMode->Disable();
+        settingsNumaReplicas->Disable();
+        settingsDatasetCache->Disable();
+        settingsDatasetSnapshots->Disable();
     }
 
     void wxPowerFrame::OnCheckBox(wxCommandEvent& event)
@@ -535,6 +886,26 @@ namespace wxpower
     {
         using State = ProveV0Manager::State;
 
+        if (proveV0Pending)
+        {
+            if (prewarm->isFinished())
+            {
+                prewarm.reset();
+                proveV0Pending = false;
+
+                BeginProveV0();
+                DisableProveElements();
+            }
+        }
+        else if (!proveV0Mgr && !benchmark)
+            UpdatePrewarm();
+
+        if (verifyJob)
+            UpdateVerify();
+
+        if (benchmark)
+            UpdateBenchmark();
+
         if (proveV0Mgr)
         {
             const ProveV0Manager::MasterGuarded masterGuarded =
@@ -579,8 +950,42 @@ namespace wxpower
                     ss << "\nInitialization finished - time: "
                         << masterGuarded.rxTime.value()
                         << " s";
+
+                    if (masterGuarded.rxReused)
+                        ss << " (reused dataset from an earlier prove)";
+                    else if (masterGuarded.rxFromSnapshot)
+                        ss << " (loaded dataset snapshot from disk)";
+                    else if (masterGuarded.rxResumedItems.has_value())
+                        ss << " (resumed a cancelled dataset build at "
+                            << masterGuarded.rxResumedItems.value() << " items)";
+
+                    if (masterGuarded.rxMode == RxMode::light)
+                        ss << "\nProving in light mode (cache only); hashing is several times slower.";
+
+                    for (const RxInitThreadStats& stats : masterGuarded.rxInitStats)
+                        ss << "\nInit thread on core " << stats.core << ": "
+                            << stats.items << " items, "
+                            << ((stats.seconds > 0.0) ? (stats.items / stats.seconds) : 0.0)
+                            << " items/s";
+
+                    if (masterGuarded.rxReplicas > 0)
+                        ss << "\nDataset copies on NUMA nodes: " << masterGuarded.rxReplicas;
+
+                    for (size_t i = 0; i < masterGuarded.warnings.size(); i++)
+                        ss << "\nWarning: \"" << masterGuarded.warnings.at(i) << "\"";
+
+                    if (masterGuarded.resumedHashes.has_value())
+                        ss << "\nResumed from checkpoint after "
+                            << masterGuarded.resumedHashes.value()
+                            << " earlier hashes.";
                 }
 
+                if (masterGuarded.rxMode == RxMode::hybrid)
+                    ss << "\nHashing in light mode while the dataset is built.";
+                else if (masterGuarded.rxDatasetTime.has_value())
+                    ss << "\nDataset built; switched to full mode after "
+                        << masterGuarded.rxDatasetTime.value() << " s of hashing.";
+
                 ss << "\nHashing progress:";
                 DumpProveV0Info(ss, proveV0Mgr, masterGuarded);
 